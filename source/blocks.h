@@ -41,10 +41,11 @@ static bool blockLegal(Position& state, std::vector<Block>& blocks, Position& mo
 		bool block_moved = true;
 		bool block_stationary = true;
 		
-		Block test = blocks[i];
+		Block& test = blocks[i];
 		for (set_iter = test.begin(); set_iter != test.end(); set_iter++){
+			std::set<int>& changedSet = changed[set_iter->first];
 			for (piece_iter = set_iter->second.begin(); piece_iter != set_iter->second.end(); piece_iter++){
-				if (changed[set_iter->first].find(*piece_iter) == changed[set_iter->first].end())
+				if (changedSet.find(*piece_iter) == changedSet.end())
 					block_moved = false;
 				else 
 					block_stationary = false;
@@ -56,4 +57,42 @@ static bool blockLegal(Position& state, std::vector<Block>& blocks, Position& mo
 	return true;
 }
 
+// blockLegal for compiled states. A block may move if the move takes all or
+// none of its pieces along.
+static bool blockLegal(const unsigned char* state, CompiledPuzzle& puzzle, const compiledmove& move){
+	if (!puzzle.blockMasks.empty()) {
+		unsigned long long moved = 0;
+		for (unsigned int i = 0; i < move.blockSlots.size(); i++)
+			moved |= puzzle.blockPieces[move.blockSlots[i].second + state[move.blockSlots[i].first]];
+		for (unsigned int b = 0; b < puzzle.blockMasks.size(); b++){
+			unsigned long long inBlock = moved & puzzle.blockMasks[b];
+			if (inBlock != 0 && inBlock != puzzle.blockMasks[b])
+				return false;
+		}
+		return true;
+	}
+
+	// too many pieces in blocks for the masks
+	for (unsigned int b = 0; b < puzzle.blocks.size(); b++){
+		bool block_moved = true;
+		bool block_stationary = true;
+		
+		std::vector<std::pair<int, int> >& test = puzzle.blocks[b];
+		for (unsigned int j = 0; j < test.size(); j++){
+			compiledset& set = puzzle.sets[test[j].first];
+			bool changed = false;
+			for (int i = 0; i < set.size; i++)
+				if (state[set.poffset + i] == test[j].second && move.moved[set.poffset + i])
+					changed = true;
+			if (changed)
+				block_stationary = false;
+			else
+				block_moved = false;
+		}
+		if (!block_moved && !block_stationary)
+			return false;
+	}
+	return true;
+}
+
 #endif
@@ -0,0 +1,604 @@
+/*
+ KSolve+ - Puzzle solving program.
+ Copyright (C) 2007-2013 Kre Krig and Michael Gottlieb
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Functions for compiling the puzzle into the flat form used by the search.
+
+#ifndef COMPILE_H
+#define COMPILE_H
+
+// Build the compiled puzzle from the rules. The pruning tables are added later
+// with attachTables.
+static CompiledPuzzle compilePuzzle(PieceTypes& datasets, Position& solved, MoveList& moves, std::vector<Block>& blocks, std::set<MovePair>& forbidden, std::set<MovePair>& commuting) {
+	CompiledPuzzle puzzle;
+
+	// number the sets, and lay out each one as permutation then orientation
+	int offset = 0;
+	PieceTypes::iterator iter;
+	for (iter = datasets.begin(); iter != datasets.end(); iter++) {
+		if (iter->second.size > MAX_COMPILED_VALUE) {
+			std::cerr << "Set " << iter->first << " has too many pieces (max " << MAX_COMPILED_VALUE << ").\n";
+			exit(-1);
+		}
+		if (iter->second.omod > MAX_COMPILED_VALUE / 2) {
+			std::cerr << "Set " << iter->first << " has too many orientations (max " << MAX_COMPILED_VALUE / 2 << ").\n";
+			exit(-1);
+		}
+		compiledset set;
+		set.name = iter->first;
+		set.size = iter->second.size;
+		set.omod = iter->second.omod;
+		set.poffset = offset;
+		set.ooffset = offset + set.size;
+		set.uniqueperm = iter->second.uniqueperm;
+		set.tables = NULL;
+		set.pcoord = -1;
+		set.ocoord = -1;
+		set.invertible = false;
+		puzzle.setIndex[iter->first] = puzzle.sets.size();
+		puzzle.sets.push_back(set);
+		offset += 2 * set.size;
+	}
+	puzzle.stateSize = offset;
+
+	// permutation bytes never wrap, orientation bytes wrap at omod
+	puzzle.modulus.resize(puzzle.stateSize);
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		for (int i = 0; i < puzzle.sets[s].size; i++) {
+			puzzle.modulus[puzzle.sets[s].poffset + i] = 255;
+			puzzle.modulus[puzzle.sets[s].ooffset + i] = puzzle.sets[s].omod;
+		}
+	}
+
+	puzzle.solved.resize(puzzle.stateSize);
+	compilePosition(solved, puzzle, &puzzle.solved[0]);
+
+	// turn each move into a table of source bytes and orientation changes
+	MoveList::iterator moveIter;
+	for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++) {
+		compiledmove move;
+		move.id = moveIter->first;
+		move.parentID = moveIter->second.parentID;
+		move.qtm = moveIter->second.qtm;
+		move.cost.assign(1, 1); // HTM, until compileMetrics
+		move.name = moveIter->second.name;
+		move.source.resize(puzzle.stateSize);
+		move.twist.resize(puzzle.stateSize);
+		move.moved.resize(puzzle.stateSize);
+		for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+			compiledset& set = puzzle.sets[s];
+			substate& sub = moveIter->second.state[set.name];
+			for (int i = 0; i < set.size; i++) {
+				int from = sub.permutation[i] - 1;
+				move.source[set.poffset + i] = set.poffset + from;
+				move.twist[set.poffset + i] = 0;
+				move.source[set.ooffset + i] = set.ooffset + from;
+				move.twist[set.ooffset + i] = ((sub.orientation[from] % set.omod) + set.omod) % set.omod;
+				// a slot counts as moved for blocks even if its twist is 0 mod omod
+				move.moved[set.poffset + i] = (sub.permutation[i] != i+1 || sub.orientation[i] != 0);
+			}
+		}
+		puzzle.moveIndex[move.id] = puzzle.moves.size();
+		puzzle.moves.push_back(move);
+	}
+
+	// number the parent moves
+	std::map<int, int> parentIndex;
+	for (unsigned int m = 0; m < puzzle.moves.size(); m++) {
+		if (parentIndex.find(puzzle.moves[m].parentID) == parentIndex.end()) {
+			int index = parentIndex.size();
+			parentIndex[puzzle.moves[m].parentID] = index;
+		}
+		puzzle.moves[m].parent = parentIndex[puzzle.moves[m].parentID];
+	}
+
+	// which move sequences are worth searching
+	if (!buildAutomaton(puzzle, forbidden, commuting, parentIndex, true))
+		buildAutomaton(puzzle, forbidden, commuting, parentIndex, false);
+
+	// blocks become lists of (set, piece) pairs
+	for (unsigned int b = 0; b < blocks.size(); b++) {
+		std::vector<std::pair<int, int> > block;
+		Block::iterator blockIter;
+		for (blockIter = blocks[b].begin(); blockIter != blocks[b].end(); blockIter++) {
+			std::set<int>::iterator pieceIter;
+			for (pieceIter = blockIter->second.begin(); pieceIter != blockIter->second.end(); pieceIter++)
+				block.push_back(std::pair<int, int>(puzzle.setIndex[blockIter->first], *pieceIter));
+		}
+		puzzle.blocks.push_back(block);
+	}
+	compileBlockMasks(puzzle);
+	puzzle.movesInvertible = false;
+
+	return puzzle;
+}
+
+// Give each piece that is in a block its own bit, so that blockLegal can find the
+// pieces a move takes along with a few ORs. Only done if they fit in one word.
+static void compileBlockMasks(CompiledPuzzle& puzzle) {
+	std::map<std::pair<int, int>, int> bits;
+	for (unsigned int b = 0; b < puzzle.blocks.size(); b++)
+		for (unsigned int j = 0; j < puzzle.blocks[b].size(); j++)
+			if (bits.find(puzzle.blocks[b][j]) == bits.end()) {
+				int bit = bits.size();
+				bits[puzzle.blocks[b][j]] = bit;
+			}
+	if (bits.empty() || bits.size() > 64)
+		return;
+
+	int row = MAX_COMPILED_VALUE + 1;
+	puzzle.blockPieces.assign(puzzle.sets.size() * row, 0);
+	std::set<int> blockSets;
+	std::map<std::pair<int, int>, int>::iterator bitIter;
+	for (bitIter = bits.begin(); bitIter != bits.end(); bitIter++) {
+		puzzle.blockPieces[bitIter->first.first * row + bitIter->first.second] = 1ULL << bitIter->second;
+		blockSets.insert(bitIter->first.first);
+	}
+	for (unsigned int b = 0; b < puzzle.blocks.size(); b++) {
+		unsigned long long mask = 0;
+		for (unsigned int j = 0; j < puzzle.blocks[b].size(); j++)
+			mask |= 1ULL << bits[puzzle.blocks[b][j]];
+		puzzle.blockMasks.push_back(mask);
+	}
+
+	// the slots each move moves, in the sets that have pieces in blocks
+	for (unsigned int m = 0; m < puzzle.moves.size(); m++) {
+		compiledmove& move = puzzle.moves[m];
+		std::set<int>::iterator setIter;
+		for (setIter = blockSets.begin(); setIter != blockSets.end(); setIter++) {
+			compiledset& set = puzzle.sets[*setIter];
+			for (int i = 0; i < set.size; i++)
+				if (move.moved[set.poffset + i])
+					move.blockSlots.push_back(std::pair<int, int>(set.poffset + i, *setIter * row));
+		}
+	}
+}
+
+// Compile a scramble's MoveLimits, and how many moves each one allows at the start.
+// A limit's owned pieces can't move once it is used up, so they have to be solved
+// by then, in both permutation and orientation (unless they are ignored).
+static void compileLimits(std::vector<MoveLimit>& moveLimits, CompiledPuzzle& puzzle, std::vector<unsigned char>& ignore, CompiledLimits& limits, LimitCounts& counts) {
+	if (moveLimits.size() > (unsigned int)MAX_MOVE_LIMITS) {
+		std::cerr << "Too many MoveLimits, at most " << MAX_MOVE_LIMITS << " are allowed.\n";
+		exit(-1);
+	}
+	limits.count = moveLimits.size();
+	limits.moves.assign(puzzle.moves.size(), 0);
+	limits.owned.assign(limits.count, std::vector<int>());
+	for (int l = 0; l < limits.count; l++) {
+		counts.left[l] = moveLimits[l].limit;
+		for (unsigned int m = 0; m < puzzle.moves.size(); m++)
+			if (limitMatches(moveLimits[l], puzzle.moves[m]))
+				limits.moves[m] |= 1u << l;
+		Block::iterator iter;
+		for (iter = moveLimits[l].owned.begin(); iter != moveLimits[l].owned.end(); iter++) {
+			compiledset& set = puzzle.sets[puzzle.setIndex[iter->first]];
+			std::set<int>::iterator piece;
+			for (piece = iter->second.begin(); piece != iter->second.end(); piece++) {
+				int slot = set.poffset + *piece;
+				if (ignore.empty() || ignore[slot] == 0)
+					limits.owned[l].push_back(slot);
+				slot = set.ooffset + *piece;
+				if (set.omod > 1 && (ignore.empty() || ignore[slot] == 0))
+					limits.owned[l].push_back(slot);
+			}
+		}
+	}
+}
+
+// Give the compiled puzzle its pruning tables, once they are built or loaded.
+// The parts of the joint tables are all coordinates (see jointLayout); the ones
+// that track some pieces are coordinates of their own, with no table, and
+// joint tables that track the same pieces share them.
+static void attachTables(CompiledPuzzle& puzzle, PieceTypes& datasets, PruneTable& tables, JointTables& joints) {
+	puzzle.coords.clear();
+	puzzle.joints.clear();
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		set.ptabletype = datasets[set.name].ptabletype;
+		set.otabletype = datasets[set.name].otabletype;
+		set.tables = &tables[set.name];
+		set.pcoord = -1;
+		set.ocoord = -1;
+		if (set.otabletype == TABLE_TYPE_COMPLETE && set.tables->orientation.size() <= 1)
+			set.otabletype = TABLE_TYPE_NONE; // nothing to learn from a single entry
+
+		// complete tables with a move table are tracked as coordinates
+		compiledcoord coord;
+		coord.set = s;
+		coord.other = 0;
+		if (set.otabletype == TABLE_TYPE_COMPLETE && !set.tables->orientationmoves.empty()) {
+			coord.table = &set.tables->orientation;
+			coord.moves = &set.tables->orientationmoves;
+			coord.orientation = true;
+			set.ocoord = puzzle.coords.size();
+			puzzle.coords.push_back(coord);
+		}
+		if (set.ptabletype == TABLE_TYPE_COMPLETE && !set.tables->permutationmoves.empty()) {
+			coord.table = &set.tables->permutation;
+			coord.moves = &set.tables->permutationmoves;
+			coord.orientation = false;
+			set.pcoord = puzzle.coords.size();
+			puzzle.coords.push_back(coord);
+		}
+	}
+
+	int nMoves = puzzle.moves.size();
+	for (unsigned int j = 0; j < joints.size(); j++) {
+		compiledjoint joint;
+		joint.name = joints[j].name;
+		joint.table = &joints[j].table;
+		joint.stride.assign(joints[j].parts.size(), 1);
+		long long stride = 1;
+		for (int k = joints[j].parts.size() - 1; k >= 0; k--) {
+			JointPart& part = joints[j].parts[k];
+			int s = puzzle.setIndex[part.set];
+			compiledset& set = puzzle.sets[s];
+			int c = part.orientation ? set.ocoord : set.pcoord;
+			if (!part.pieces.empty()) {
+				compiledcoord coord;
+				coord.set = s;
+				coord.table = NULL;
+				coord.moves = &joints[j].subsetMoves[k];
+				coord.orientation = part.orientation;
+				std::vector<int> solved (puzzle.solved.begin() + set.poffset, puzzle.solved.begin() + set.poffset + set.size);
+				coord.other = subsetTracked(part, &solved[0], set.size, coord.tracked);
+				for (c = 0; c < (int)puzzle.coords.size(); c++)
+					if (puzzle.coords[c].set == s && puzzle.coords[c].orientation == coord.orientation && puzzle.coords[c].tracked == coord.tracked)
+						break;
+				if (c == (int)puzzle.coords.size())
+					puzzle.coords.push_back(coord);
+			}
+			joint.coords.insert(joint.coords.begin(), c);
+			joint.stride[k] = stride;
+			stride *= puzzle.coords[c].moves->size() / nMoves;
+		}
+		puzzle.joints.push_back(joint);
+	}
+}
+
+// Build the automaton of allowed move sequences. For each parent move b done so
+// far, a state remembers which parents were done after the last b. A move a is
+// not allowed if, for some b, a commutes with everything done after b and either
+// has the same parent as b (they could be merged) or commutes with b and belongs
+// before it (the order we skip). This leaves one order for any sequence of
+// commuting moves, e.g. R U L and L R U on a 3x3x3 are only searched once. The
+// last move is also remembered, for the forbidden pairs. Without trackCommuting
+// only the last move is looked at. Returns false if the automaton would be too
+// large.
+static bool buildAutomaton(CompiledPuzzle& puzzle, std::set<MovePair>& forbidden, std::set<MovePair>& commuting, std::map<int, int>& parentIndex, bool trackCommuting) {
+	int nMoves = puzzle.moves.size();
+	int nParents = parentIndex.size();
+	if (nParents > 30) // parents after each b are kept as a bitmask
+		trackCommuting = false;
+
+	// commuting parent pairs (as bitmasks, when tracking), and the order we skip
+	std::vector<char> skip (nParents * nParents, 0);
+	std::vector<int> commutes (nParents, 0);
+	for (int p = 0; p < nParents && trackCommuting; p++)
+		commutes[p] = 1 << p;
+	std::set<MovePair>::iterator pairIter;
+	for (pairIter = commuting.begin(); pairIter != commuting.end(); pairIter++) {
+		if (parentIndex.find(pairIter->first) == parentIndex.end() || parentIndex.find(pairIter->second) == parentIndex.end())
+			continue;
+		int a = parentIndex[pairIter->first];
+		int b = parentIndex[pairIter->second];
+		skip[a * nParents + b] = 1;
+		if (trackCommuting) {
+			commutes[a] |= 1 << b;
+			commutes[b] |= 1 << a;
+		}
+	}
+
+	// a state is (parents done after each b, or -1 if b doesn't matter; last move),
+	// numbered as we find them
+	typedef std::pair<std::vector<int>, int> AutomatonKey;
+	std::map<AutomatonKey, int> index;
+	std::vector<AutomatonKey> states;
+	states.push_back(AutomatonKey(std::vector<int>(nParents, -1), -1));
+	index[states[0]] = 0;
+	puzzle.automaton.clear();
+
+	for (unsigned int st = 0; st < states.size(); st++) {
+		if ((long long) states.size() * nMoves > MAX_AUTOMATON_SIZE)
+			return false;
+		AutomatonKey key = states[st];
+		for (int m = 0; m < nMoves; m++) {
+			int p = puzzle.moves[m].parent;
+			bool allowed = (key.second == -1 || forbidden.find(MovePair(puzzle.moves[key.second].id, puzzle.moves[m].id)) == forbidden.end());
+			for (int b = 0; b < nParents && allowed; b++)
+				if (key.first[b] != -1 && (key.first[b] & ~commutes[p]) == 0 && (b == p || skip[b * nParents + p]))
+					allowed = false;
+			if (!allowed) {
+				puzzle.automaton.push_back(-1);
+				continue;
+			}
+
+			// update what was done after each parent, and forget the parents
+			// that can no longer stop any move
+			AutomatonKey next (key.first, m);
+			for (int b = 0; b < nParents; b++) {
+				if (b == p)
+					next.first[b] = 0;
+				else if (next.first[b] != -1 && trackCommuting)
+					next.first[b] |= 1 << p;
+				else
+					next.first[b] = -1;
+				if (next.first[b] == -1)
+					continue;
+				bool matters = false;
+				for (int a = 0; a < nParents && !matters; a++)
+					if ((next.first[b] & ~commutes[a]) == 0 && (a == b || skip[b * nParents + a]))
+						matters = true;
+				if (!matters)
+					next.first[b] = -1;
+			}
+			if (index.find(next) == index.end()) {
+				index[next] = states.size();
+				states.push_back(next);
+			}
+			puzzle.automaton.push_back(index[next]);
+		}
+	}
+	puzzle.automatonStates = states.size();
+	return true;
+}
+
+// Convert a position into a flat state. Unknown pieces (-1) become 0, and
+// sets missing from the position are taken from the solved state.
+static void compilePosition(Position& position, CompiledPuzzle& puzzle, unsigned char* state) {
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		Position::iterator iter = position.find(set.name);
+		if (iter == position.end()) {
+			memcpy(state + set.poffset, &puzzle.solved[set.poffset], 2 * set.size);
+			continue;
+		}
+		for (int i = 0; i < set.size; i++) {
+			int p = iter->second.permutation[i];
+			if (p > MAX_COMPILED_VALUE) {
+				std::cerr << "Piece number " << p << " in set " << set.name << " is too large.\n";
+				exit(-1);
+			}
+			state[set.poffset + i] = (p < 0) ? 0 : p;
+			state[set.ooffset + i] = ((iter->second.orientation[i] % set.omod) + set.omod) % set.omod;
+		}
+	}
+}
+
+// Compute the tracked coordinates of a flat state from scratch
+static void computeCoords(unsigned char* state, CompiledPuzzle& puzzle, int* coords) {
+	for (unsigned int c = 0; c < puzzle.coords.size(); c++)
+		coords[c] = coordValue(state, puzzle, c);
+}
+
+// One tracked coordinate of a flat state, from scratch
+static int coordValue(unsigned char* state, CompiledPuzzle& puzzle, int c) {
+	compiledcoord& coord = puzzle.coords[c];
+	compiledset& set = puzzle.sets[coord.set];
+	if (!coord.tracked.empty()) {
+		int permutation[MAX_COMPILED_VALUE];
+		int orientation[MAX_COMPILED_VALUE];
+		for (int i = 0; i < set.size; i++) {
+			permutation[i] = state[set.poffset + i];
+			orientation[i] = state[set.ooffset + i];
+		}
+		return subsetIndex(permutation, orientation, set.size, coord.tracked, coord.other, coord.orientation ? set.omod : 1);
+	}
+	if (coord.orientation)
+		return oVector2Index(state + set.ooffset, set.size, set.omod);
+	else if (set.uniqueperm)
+		return pVector2Index(state + set.poffset, set.size);
+	return pVector3Index(state + set.poffset, set.size);
+}
+
+// Convert an ignore position into a flat mask (1 = ignore this byte).
+// The mask is empty if nothing is ignored.
+static std::vector<unsigned char> compileIgnore(Position& ignore, CompiledPuzzle& puzzle) {
+	std::vector<unsigned char> mask (puzzle.stateSize, 0);
+	bool ignoring = false;
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		Position::iterator iter = ignore.find(set.name);
+		if (iter == ignore.end()) continue;
+		for (int i = 0; i < set.size; i++) {
+			mask[set.poffset + i] = (iter->second.permutation[i] != 0);
+			mask[set.ooffset + i] = (iter->second.orientation[i] != 0);
+			if (mask[set.poffset + i] || mask[set.ooffset + i])
+				ignoring = true;
+		}
+	}
+	if (!ignoring)
+		mask.clear();
+	return mask;
+}
+
+// Turn an ignore mask from compileIgnore into masks that compare a state with
+// the solved state 8 bytes at a time. A set's orientation or permutation
+// pruning table is skipped if the scramble ignores all of it: the table only
+// knows the way to the solved state, which may be further than a position
+// that counts as solved.
+static void compileIgnoreMasks(std::vector<unsigned char>& ignore, CompiledPuzzle& puzzle, IgnoreMasks& masks) {
+	int words = (puzzle.stateSize + 7) / 8;
+	masks.mask.assign(words, 0);
+	masks.solved.assign(words, 0);
+	for (int i = 0; i < puzzle.stateSize; i++) {
+		if (!ignore.empty() && ignore[i])
+			continue;
+		masks.mask[i / 8] |= 0xFFULL << (8 * (i % 8));
+		masks.solved[i / 8] |= (unsigned long long)puzzle.solved[i] << (8 * (i % 8));
+	}
+
+	masks.skip.assign(2 * puzzle.sets.size() + puzzle.joints.size(), 0);
+	if (ignore.empty())
+		return;
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		bool orientation = true;
+		bool permutation = true;
+		for (int i = 0; i < set.size; i++) {
+			orientation = orientation && ignore[set.ooffset + i];
+			permutation = permutation && ignore[set.poffset + i];
+		}
+		masks.skip[2 * s] = orientation;
+		masks.skip[2 * s + 1] = permutation;
+	}
+
+	// a joint table asks for all its parts to be solved, so it is skipped if
+	// the table of any of them is. Pieces are tracked by where they are, so
+	// that is also skipped if their set's permutation is.
+	for (unsigned int j = 0; j < puzzle.joints.size(); j++) {
+		compiledjoint& joint = puzzle.joints[j];
+		for (unsigned int k = 0; k < joint.coords.size(); k++) {
+			compiledcoord& coord = puzzle.coords[joint.coords[k]];
+			bool skipped = masks.skip[2 * coord.set + (coord.orientation ? 0 : 1)];
+			if (!coord.tracked.empty())
+				skipped = skipped || masks.skip[2 * coord.set + 1];
+			if (skipped)
+				masks.skip[2 * puzzle.sets.size() + j] = 1;
+		}
+	}
+}
+
+// Find the sets whose orientation tables can also be looked up for the inverse
+// of a position, and what each move does to the inverse. A permutation table
+// gives a position and its inverse the same value, but the orientation of the
+// inverse depends on where the pieces are, so it can show a position needs more
+// moves than its own orientation does. This only works if the inverse of every
+// move is a move too, and if the set is solved as 1, 2, 3... with no twists and
+// with nothing the def file ignores. Call after attachTables.
+static void compileInverses(CompiledPuzzle& puzzle, std::vector<unsigned char>& ignore) {
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		set.invertible = set.uniqueperm && set.otabletype != TABLE_TYPE_NONE;
+		for (int i = 0; i < set.size && set.invertible; i++)
+			if (puzzle.solved[set.poffset + i] != i + 1 || puzzle.solved[set.ooffset + i] != 0 ||
+				(!ignore.empty() && (ignore[set.poffset + i] || ignore[set.ooffset + i])))
+				set.invertible = false;
+	}
+
+	int nMoves = puzzle.moves.size();
+	puzzle.movesInvertible = true;
+	for (int m = 0; m < nMoves && puzzle.movesInvertible; m++)
+		puzzle.movesInvertible = (inverseMove(puzzle, m) != -1);
+
+	// doing the inverse of move m first takes the piece in slot i of a position to
+	// the slot m takes i from, and undoes the twist m gives it there
+	for (int m = 0; m < nMoves; m++) {
+		compiledmove& move = puzzle.moves[m];
+		move.inverseLabel.assign(puzzle.stateSize, 0);
+		move.inverseTwist.assign(puzzle.stateSize, 0);
+		for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+			compiledset& set = puzzle.sets[s];
+			if (!set.invertible)
+				continue;
+			for (int i = 0; i < set.size; i++) {
+				int from = move.source[set.poffset + i] - set.poffset;
+				move.inverseLabel[set.poffset + from] = i + 1;
+				move.inverseTwist[set.poffset + from] = (set.omod - move.twist[set.ooffset + i]) % set.omod;
+			}
+		}
+	}
+}
+
+// The move that undoes move m: doing one after the other changes nothing. -1
+// if there is none.
+static int inverseMove(CompiledPuzzle& puzzle, int m) {
+	compiledmove& move = puzzle.moves[m];
+	for (unsigned int n = 0; n < puzzle.moves.size(); n++) {
+		compiledmove& inverse = puzzle.moves[n];
+		bool found = true;
+		for (int i = 0; i < puzzle.stateSize && found; i++) {
+			int from = inverse.source[i];
+			found = (move.source[from] == i && (move.twist[from] + inverse.twist[i]) % puzzle.modulus[i] == 0);
+		}
+		if (found)
+			return n;
+	}
+	return -1;
+}
+
+// Give each move its cost in each metric, from the costs by MoveList ID. The
+// pruning tables measure how far positions are from solved, not the other way,
+// so a move and its inverse must cost the same.
+static void compileMetrics(CompiledPuzzle& puzzle, std::vector<std::map<int, int> >& metrics) {
+	for (unsigned int m = 0; m < puzzle.moves.size(); m++) {
+		compiledmove& move = puzzle.moves[m];
+		move.cost.clear();
+		for (unsigned int k = 0; k < metrics.size(); k++)
+			move.cost.push_back(metrics[k][move.id]);
+	}
+	for (unsigned int m = 0; m < puzzle.moves.size(); m++) {
+		int inverse = inverseMove(puzzle, m);
+		if (inverse != -1 && puzzle.moves[m].cost != puzzle.moves[inverse].cost) {
+			std::cerr << "Moves " << puzzle.moves[m].name << " and " << puzzle.moves[inverse].name << " undo each other, so MoveCost must give them the same cost.\n";
+			exit(-1);
+		}
+	}
+}
+
+// The least a move costs in metric k (1 if there are no moves)
+static int minMoveCost(CompiledPuzzle& puzzle, int k) {
+	int least = 0;
+	for (unsigned int m = 0; m < puzzle.moves.size(); m++)
+		if (least == 0 || puzzle.moves[m].cost[k] < least)
+			least = puzzle.moves[m].cost[k];
+	return (least == 0) ? 1 : least;
+}
+
+// The invertible sets a scramble can use for inverse pruning: the ones it
+// doesn't ignore any of, and has every piece of in some slot
+static std::vector<int> inverseSets(unsigned char* state, std::vector<unsigned char>& ignore, CompiledPuzzle& puzzle) {
+	std::vector<int> sets;
+	if (!puzzle.movesInvertible)
+		return sets;
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		if (!set.invertible)
+			continue;
+		std::vector<char> seen(set.size + 1, 0);
+		bool usable = true;
+		for (int i = 0; i < set.size && usable; i++) {
+			int piece = state[set.poffset + i];
+			usable = (piece >= 1 && piece <= set.size && !seen[piece]);
+			if (usable)
+				seen[piece] = 1;
+			if (!ignore.empty() && (ignore[set.poffset + i] || ignore[set.ooffset + i]))
+				usable = false;
+		}
+		if (usable)
+			sets.push_back(s);
+	}
+	return sets;
+}
+
+// The inverse of a position, in the given sets: the piece in slot i goes to the
+// slot numbered by the piece, with the opposite twist
+static void invertPosition(unsigned char* state, unsigned char* inverse, CompiledPuzzle& puzzle, std::vector<int>& sets) {
+	memcpy(inverse, state, puzzle.stateSize);
+	for (unsigned int k = 0; k < sets.size(); k++) {
+		compiledset& set = puzzle.sets[sets[k]];
+		for (int i = 0; i < set.size; i++) {
+			int piece = state[set.poffset + i] - 1;
+			inverse[set.poffset + piece] = i + 1;
+			inverse[set.ooffset + piece] = (set.omod - state[set.ooffset + i]) % set.omod;
+		}
+	}
+}
+
+#endif
@@ -32,12 +32,76 @@ static const int MAX_COMPLETE_PERMUTATION_TABLE_SIZE = 10000000; // >10! (perm o
 static const int MAX_COMPLETE_ORIENTATION_TABLE_SIZE = 10000000; // Complete tables contain one int (4 byte) per entry.
 static const int MAX_PARTIAL_PERMUTATION_TABLE_SIZE = 1000000; // Max number of entries in a partial table.
 static const int MAX_PARTIAL_ORIENTATION_TABLE_SIZE = 1000000; // SIZE is number of entries.
+static const int MAX_MOVE_TABLE_SIZE = 20000000; // Max entries (table size * number of moves) in one move table.
+static const long long MAX_JOINT_TABLE_SIZE = 300000000; // Max entries (bytes) in a table of the PruneTable command.
+
+// Largest piece number or set size that fits in one byte of a compiled state.
+static const int MAX_COMPILED_VALUE = 254;
+
+// Max entries (states * moves) in the automaton of allowed move sequences.
+static const int MAX_AUTOMATON_SIZE = 10000000;
+
+// Limits for finding symmetries.
+static const unsigned int MAX_SYMMETRIES = 1000; // Give up on symmetries if there are more than this
+static const int MAX_SYMMETRY_TRIES = 1000000; // Mappings of the moves (or slot guesses) to try
+
+// Splitting the top of the search tree between threads.
+static const int SPLIT_NODES_PER_THREAD = 16; // Subtrees per thread when splitting adaptively
+static const int MAX_SPLIT_NODES = 1000000; // Never hold more subtrees than this in memory
+
+// Bytes of solutions a search thread collects before writing them out.
+static const unsigned int SINK_BUFFER_SIZE = 65536;
+
+// What to do with the solutions.
+static const int OUTPUT_TEXT = 0; // One line of moves per solution
+static const int OUTPUT_JSON = 1; // One JSON object per solution
+static const int OUTPUT_COUNT = 2; // Only the number of solutions
+
+// The order prune looks at the pruning tables in.
+static const int PRUNE_ORDER_FIXED = 0; // Joint tables and coordinates first, then by set
+static const int PRUNE_ORDER_TABLE = 1; // As estimated from the values in the tables
+static const int PRUNE_ORDER_ADAPTIVE = 2; // As measured at the depths searched so far
+
+// Positions with less depth left than this are not put in the transposition table.
+static const int MIN_TABLE_DEPTH = 2;
+
+// Max positions kept from the scramble side of a meet in the middle search.
+static const int MAX_MITM_NODES = 10000000;
+
+// Max positions kept in the frontier cache between depths (see --frontier).
+static const int MAX_FRONTIER_NODES = 4000000;
+
+// The ways a scramble can be searched.
+static const int SEARCH_MODE_IDA = 0; // Iterative deepening tree search
+static const int SEARCH_MODE_MITM = 1; // Meet in the middle
+
+// Pruning table value of a position a phase can't solve with its moves.
+static const char PHASE_UNREACHABLE = 127;
+
+// Most a move can cost with the MoveCost command, so that pruning table values
+// stay below PHASE_UNREACHABLE.
+static const int MAX_MOVE_COST = 10;
+
+// SearchContext::excess when no node was cut off for lack of depth.
+static const int NO_EXCESS = 1 << 30;
+
+// Nodes a search thread visits between checks of the node and time limits.
+static const int BUDGET_CHECK_NODES = 1024;
 
 // The types of pruning tables. 
 static const int TABLE_TYPE_NONE = 0;
 static const int TABLE_TYPE_COMPLETE = 1;
 static const int TABLE_TYPE_PARTIAL = 2;
 
+// Complete pruning tables with fewer entries than this are built at the same
+// time as each other, one thread each; larger ones use every thread.
+static const long long PARALLEL_TABLE_SIZE = 1 << 16;
+
+// The kinds of complete pruning tables (see TableJob).
+static const int TABLE_JOB_ORIENTATION = 0;
+static const int TABLE_JOB_PERMUTATION = 1; // unique pieces
+static const int TABLE_JOB_PERMUTATION3 = 2; // not unique pieces
+
 // Some general data for a set of pieces
 struct dataset{
 	int type;
@@ -64,6 +128,8 @@ struct subprune{
 	std::map<std::vector<long long>, char> partialpermutation;
 	int partialpermutation_depth;
 	int partialorientation_depth;
+	std::vector<int> orientationmoves; // move tables for complete tables: [index * moves + move]
+	std::vector<int> permutationmoves;
 };
 
 // some typedefs to make things easier
@@ -74,6 +140,42 @@ typedef std::pair<int, int> MovePair;
 typedef std::map<string, subprune> PruneTable;
 typedef std::map<string, dataset> PieceTypes;
 
+// A part of a table of the PruneTable command: the permutation or orientation
+// of a set, or where some of its pieces are (and how they are twisted, for
+// orientation). Pieces that aren't tracked count as one more piece number,
+// above the ones of the set.
+struct JointPart {
+	string name; // as written in the def file
+	string set;
+	bool orientation;
+	std::vector<int> pieces; // the piece numbers tracked, or empty for the whole set
+};
+
+// A pruning table over the permutations and orientations of several sets at
+// once, from the PruneTable command of the def file. An entry is indexed by the
+// coordinates of its parts, the first part's coordinate varying slowest.
+struct JointTable {
+	string name; // the parts, as written in the def file
+	std::vector<JointPart> parts;
+	std::vector<std::vector<int> > subsetMoves; // [part] -> move table of a part with pieces, or empty
+	std::vector<char> table;
+};
+typedef std::vector<JointTable> JointTables;
+
+// A complete pruning table to build, and where it goes
+struct TableJob {
+	int type; // TABLE_JOB_ORIENTATION, TABLE_JOB_PERMUTATION or TABLE_JOB_PERMUTATION3
+	string setname;
+	std::vector<int> solved;
+	std::vector<int> ignore;
+	int omod;
+	long long size; // entries in the table
+	std::vector<char>* table;
+	std::vector<int>* moveTable; // the set's move table, or empty
+
+	TableJob(int type, string setname, std::vector<int> ignore, std::vector<char>& table, std::vector<int>& moveTable) : type(type), setname(setname), ignore(ignore), omod(1), size(0), table(&table), moveTable(&moveTable) {}
+};
+
 // all the information needed to describe a possible move
 struct fullmove {
 	string name;
@@ -91,17 +193,322 @@ struct MoveLimit {
 	Block owned; // pieces that can only be affected by these moves
 };
 
+// Most MoveLimits a scramble can have
+static const int MAX_MOVE_LIMITS = 32;
+
+// A scramble's MoveLimits, compiled for the search
+struct CompiledLimits {
+	int count;
+	std::vector<unsigned int> moves; // [move] -> bit l is set if the move counts against limit l
+	std::vector<std::vector<int> > owned; // [limit] -> bytes that have to be solved once the limit is used up
+};
+
+// What a scramble ignores, compiled for the solved check and for pruning
+struct IgnoreMasks {
+	std::vector<unsigned long long> mask; // 8 bytes of the state per word, 0xFF for each byte that has to be solved
+	std::vector<unsigned long long> solved; // the solved state, masked
+	std::vector<char> skip; // [pruning table] -> 1 if the scramble ignores everything that table looks at
+};
+
+// How many more moves each limit allows; small enough to copy for every subtree
+struct LimitCounts {
+	int left[MAX_MOVE_LIMITS];
+};
+
+// A phase of a phased search (see the Phases command of the scramble file)
+struct PhaseDef {
+	string name;
+	Position ignore; // what the phase doesn't have to solve
+	std::vector<int> moves; // MoveList IDs of the moves the phase may use, or empty for all of them
+};
+
 struct ScrambleDef {
 	string name;
 	Position state;
 	Position ignore;
 	int max_depth;
 	int slack;
-	int metric; // 0 = HTM, 1 = QTM
+	int metric; // what the moves cost, as an index in Scramble::getMetrics (0 = HTM)
 	int printState; // 0 = no, 1 = yes
+	int searchMode; // SEARCH_MODE_IDA or SEARCH_MODE_MITM
+	int maxSolutions; // stop after this many solutions, 0 = no limit
+	long long nodeLimit; // stop after about this many nodes, 0 = no limit
+	double timeLimit; // stop after this many seconds, 0 = no limit
+	int phases; // the Phases to solve it in (see Scramble::getPhases), or -1 to solve it in one go
 	std::vector<MoveLimit> moveLimits;
 };
 
 typedef std::map<int, fullmove> MoveList;
 
+// What a symmetry does to one set: the piece in slot i goes to slot[i], and
+// piece number p is renamed label[p]
+struct setsymmetry {
+	std::vector<int> slot;
+	std::vector<int> label;
+};
+
+// A set of pieces in the compiled puzzle
+struct compiledset {
+	string name;
+	int size;
+	int omod;
+	int poffset; // start of this set's permutation in a flat state
+	int ooffset; // start of this set's orientation in a flat state
+	bool uniqueperm;
+	int ptabletype;
+	int otabletype;
+	int pcoord; // index in the compiled coordinates, or -1 if the search computes it from the state
+	int ocoord;
+	bool invertible; // solved is 1, 2, 3... with no twists or ignored pieces, so a position of the set has an inverse
+	subprune* tables;
+	std::vector<setsymmetry> symmetries; // the different things the puzzle's symmetries do to this set, identity first
+};
+
+// A pruning coordinate that the search keeps up to date with a move table
+struct compiledcoord {
+	int set;
+	std::vector<char>* table; // pruning table, by coordinate
+	std::vector<int>* moves; // move table, [coordinate * moves + move]
+	bool orientation; // orientation coordinate (or permutation)
+	std::vector<char> tracked; // [piece number] -> 1 for the pieces of a coordinate of some pieces (see JointPart), else empty
+	int other; // what the other pieces count as then
+};
+
+// A table of the PruneTable command, looked up with the coordinates of its parts
+struct compiledjoint {
+	string name;
+	std::vector<int> coords; // [part] -> index in the compiled coordinates
+	std::vector<long long> stride; // [part] -> what its coordinate counts for in the index
+	std::vector<char>* table;
+};
+
+// A move in the compiled puzzle. Byte i of the new state is byte source[i]
+// of the old state plus twist[i] (wrapped at the modulus of byte i).
+struct compiledmove {
+	int id; // ID in the MoveList
+	int parentID;
+	int parent; // index of the parent move among the parent moves of the puzzle
+	int qtm;
+	std::vector<int> cost; // [metric] -> what the move costs (see Scramble::getMetrics)
+	string name;
+	std::vector<unsigned short> source;
+	std::vector<unsigned char> twist;
+	std::vector<unsigned char> moved; // slots affected by this move (for blocks)
+	std::vector<std::pair<int, int> > blockSlots; // moved slots of the sets in blocks, each with the set's row in blockPieces
+	std::vector<unsigned char> inverseLabel; // [poffset + piece - 1] -> what doing the inverse of this move first renames the piece to (invertible sets)
+	std::vector<unsigned char> inverseTwist; // [poffset + piece - 1] -> and the twist it adds to the piece
+};
+
+// A symmetry of the compiled puzzle: byte i of a state goes to byte slot[i], the
+// piece numbers of each set are renamed by label[set], and move m becomes move[m]
+struct compiledsymmetry {
+	std::vector<unsigned short> slot;
+	std::vector<std::vector<unsigned char> > label;
+	std::vector<int> move;
+	bool keepsOrder; // turns the move sequences we search into move sequences we search
+};
+
+// The puzzle compiled once from the rules. Sets and moves are numbered densely,
+// and a position is stateSize bytes: each set's permutation, then its orientation.
+struct CompiledPuzzle {
+	int stateSize;
+	std::vector<compiledset> sets;
+	std::vector<compiledmove> moves;
+	std::vector<compiledcoord> coords;
+	std::vector<compiledjoint> joints; // pruning table 2 * sets + j is joints[j]
+	std::vector<int> automaton; // [state * moves + move] -> next state, or -1 if the move is not allowed there
+	int automatonStates;
+	std::vector<compiledsymmetry> symmetries; // identity first
+	std::vector<unsigned char> modulus; // orientation bytes wrap at omod, permutation bytes never wrap
+	std::vector<unsigned char> solved;
+	std::vector<std::vector<double> > pruneRate; // [pruning table][depth left] -> estimated fraction of positions it cuts off
+	std::vector<std::vector<std::pair<int, int> > > blocks; // each block as (set, piece) pairs
+	std::vector<unsigned long long> blockPieces; // [set * (MAX_COMPILED_VALUE + 1) + piece] -> the piece's bit in blockMasks
+	std::vector<unsigned long long> blockMasks; // the bits of each block's pieces, or empty if there are too many pieces
+	bool movesInvertible; // the inverse of every move is a move too, so a position and its inverse are as far from solved
+	std::map<string, int> setIndex;
+	std::map<int, int> moveIndex; // MoveList ID -> index in moves
+};
+
+// A phase compiled for the search: the puzzle with only the phase's moves, and
+// pruning tables for reaching what the phase solves with them. The puzzle points
+// into the tables, so a compiled phase must not be copied.
+struct CompiledPhase {
+	string name;
+	CompiledPuzzle puzzle;
+	PruneTable tables;
+	std::vector<unsigned char> ignore; // what the phase doesn't have to solve, from compileIgnore
+};
+
+// The puzzle with pruning tables for a metric other than HTM, which count each
+// move at its cost. The puzzle points into the tables, so it must not be copied.
+struct CompiledMetric {
+	CompiledPuzzle puzzle;
+	PruneTable tables;
+	JointTables joints;
+};
+
+// Options given on the command line
+struct Options {
+	int threads; // number of search threads, 0 = let OpenMP decide
+	int splitDepth; // levels of the tree to split between threads, -1 = adaptive
+	int tableSize; // megabytes for the transposition table, 0 = no table
+	int output; // OUTPUT_TEXT, OUTPUT_JSON or OUTPUT_COUNT
+	bool batch; // solve the scrambles at the same time, one thread each
+	bool stats; // print what the search did at each depth
+	int pruneOrder; // PRUNE_ORDER_FIXED, PRUNE_ORDER_TABLE or PRUNE_ORDER_ADAPTIVE
+	bool inversePruning; // look up the inverse position in the orientation tables too
+	int frontierDepth; // moves deep to keep the top of the tree between depths, 0 = don't
+	bool frontierDedup; // keep one node for each position in the frontier
+
+	Options() : threads(0), splitDepth(-1), tableSize(0), output(OUTPUT_TEXT), batch(false), stats(false), pruneOrder(PRUNE_ORDER_TABLE), inversePruning(false), frontierDepth(0), frontierDedup(false) {}
+};
+
+// Positions known to have no solution with a given depth left. Each entry is two
+// words, (key ^ depth) and depth, so an entry torn by two threads writing at once
+// just fails to match instead of giving a wrong answer.
+struct TranspositionTable {
+	std::vector<unsigned long long> entries;
+	unsigned long long mask; // number of entries - 1
+	std::vector<unsigned long long> zobrist; // [byte * 256 + value] -> random key
+	std::vector<std::vector<int> > changed; // [move] -> bytes the move can change
+};
+
+class SolutionSink; // see sink.h
+
+// Shared by all search threads: how many solutions have been handed out, and
+// whether the search should stop. cancelled is checked at every node, so it is
+// a plain volatile flag rather than something that needs a lock to read.
+struct SearchControl {
+	long long solutions;
+	long long maxSolutions; // 0 = no limit
+	long long nodes; // counted by the threads every BUDGET_CHECK_NODES nodes
+	long long nodeLimit; // 0 = no limit
+	double startTime; // wall clock time the scramble was started
+	double timeLimit; // 0 = no limit
+	volatile bool outOfNodes;
+	volatile bool outOfTime;
+	volatile bool cancelled;
+};
+
+// Counters for the --stats option, kept by each thread and added up after each depth
+struct SearchStats {
+	std::vector<long long> pruned; // by pruning table: 2 * set for orientation, 2 * set + 1 for permutation, then the joint tables
+	std::vector<long long> checked; // how often each pruning table was looked at
+	long long inversePruned; // positions cut off by looking up their inverse
+	long long inverseChecked;
+	long long forbidden; // moves not allowed after the moves before (ForbiddenPairs, redundant or reordered moves)
+	long long blocked; // moves that would break a block
+	long long limited; // moves used up by MoveLimits, or that leave the limited pieces unsolvable
+	long long solutions;
+};
+
+// What one search thread needs besides the position: the puzzle, the rules
+// for this scramble, and the thread's own counters
+struct SearchContext {
+	CompiledPuzzle* puzzle;
+	std::vector<unsigned char>* ignore; // 1 for each byte we don't care about, or empty
+	IgnoreMasks* masks; // the same, compiled
+	std::vector<std::vector<int> >* pruneOrder; // [depth left] -> the pruning tables to look at, in order
+	std::vector<int>* inverseSets; // sets whose orientation tables are looked up for the inverse position too, or NULL
+	int metric; // index in compiledmove::cost
+	std::vector<int>* images; // symmetries whose images of each solution are printed too
+	TranspositionTable* table; // or NULL if there is none
+	SolutionSink* sink; // where the solutions go
+	SearchControl* control;
+	CompiledLimits* limits;
+	int* sequence; // the moves made so far, in a stack of the thread's own
+	int thread; // number of this thread
+	long long nodes; // nodes visited by this thread
+	long long tableHits; // positions found in the transposition table
+	long long tableMisses; // positions looked for but not found
+	SearchStats* stats; // the thread's own counters for --stats, or NULL
+	int startState; // state in the move automaton at the scramble (0 unless a phase follows others)
+	std::vector<int>* alternatives; // other moves from the scramble to the subtree, prefixLength each, or NULL
+	int prefixLength; // moves of the sequence the alternatives replace
+	int minCost; // least a move costs in the metric
+	int excess; // least extra depth a node cut off in this iteration needed, or NO_EXCESS
+};
+
+// A subtree near the root, waiting for a search thread
+struct SearchNode {
+	std::vector<unsigned char> state;
+	std::vector<unsigned char> inverse; // the inverse position, if context.inverseSets is used
+	std::vector<int> coords;
+	LimitCounts limits;
+	std::vector<int> sequence; // moves made from the scramble
+	std::vector<int> images; // symmetries whose images of each solution are printed too
+	std::vector<int> alternatives; // other moves from the scramble to this subtree (see FrontierCache)
+	int moveState; // state in the move automaton
+	int depth;
+};
+
+// A position in the frontier cache
+struct FrontierNode {
+	int cost; // cost of the moves from the scramble
+	int bound; // least depth the search gets here at: the most cost plus pruning bound on the way
+	int length; // moves from the scramble, less than the cache's level only for solved positions
+	int moveState; // state in the move automaton
+	int images; // index in FrontierCache::imageSets
+	int alternatives; // index in FrontierCache::alternatives, or -1
+};
+
+// The nodes of the search tree some moves from the scramble, found once and
+// searched on from at each depth (see --frontier). The positions and moves
+// are kept in flat arrays.
+struct FrontierCache {
+	int level; // moves from the scramble
+	int maxDepth; // the scramble's MaxDepth; positions that need more are left out
+	bool dedup; // one node for each position, with the other ways to get there as alternatives
+	bool built;
+	bool tooLarge; // more than MAX_FRONTIER_NODES, so the cache isn't used
+	int beyond; // least bound of the positions left out for MaxDepth, or NO_EXCESS
+	std::vector<FrontierNode> nodes;
+	std::vector<unsigned char> states; // [node * stateSize + i]
+	std::vector<int> moves; // [node * level + m] -> moves from the scramble
+	std::vector<LimitCounts> limits; // [node], if there are move limits
+	std::vector<std::vector<int> > imageSets; // the distinct lists of images
+	std::vector<std::vector<int> > alternatives; // other moves to a node, level each
+};
+
+// A position reached from the scramble in a meet in the middle search
+struct MitmNode {
+	int parent; // node before the last move, or -1 for the scramble
+	int move;
+	int cost; // cost of the moves from the scramble, in the scramble's metric
+	int moveState; // state in the move automaton
+};
+
+// A phased search in progress. parts and costs hold the moves (as indices in
+// the whole puzzle) and the cost of the phases before the one being searched.
+struct PhaseRun {
+	std::vector<CompiledPhase>* phases;
+	CompiledPuzzle* puzzle; // the whole puzzle
+	Options* options;
+	SolutionSink* sink; // where the solutions go
+	std::ostream* out;
+	int metric; // index in compiledmove::cost
+	std::vector<std::vector<unsigned char> > ignore; // [phase] -> what it or the scramble ignores
+	std::vector<IgnoreMasks> masks; // [phase] -> the same, compiled
+	std::vector<std::vector<std::vector<int> > > pruneOrder; // [phase] -> order of the pruning tables
+	std::vector<std::vector<int> > parts;
+	std::vector<int> costs;
+	int best; // cost of the best solution so far, or one more than MaxDepth
+	bool solutionFound;
+	long long nodes;
+	long long nodeLimit; // 0 = no limit
+	double startTime; // wall clock time the scramble was started
+	double timeLimit; // 0 = no limit
+	bool outOfNodes;
+	bool outOfTime;
+};
+
+// How a position is reduced to the part that has to match in a meet in the
+// middle search: pieces numbered merge[p] count as unknown (0), and the
+// orientation of a piece numbered p (after merging) doesn't matter if wild[p]
+struct MitmKeyRules {
+	std::vector<std::vector<char> > merge; // [set][piece number]
+	std::vector<std::vector<char> > wild; // [set][piece number]
+};
+
 #endif
@@ -0,0 +1,223 @@
+/*
+ KSolve+ - Puzzle solving program.
+ Copyright (C) 2007-2013 Kre Krig and Michael Gottlieb
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Functions for the frontier cache, which keeps the top of the search tree
+// between depths so that each depth doesn't search it again
+
+#ifndef FRONTIER_H
+#define FRONTIER_H
+
+// Set up an empty cache, level moves deep, for a scramble with this MaxDepth
+static void initFrontierCache(FrontierCache& cache, int level, int maxDepth, bool dedup){
+	cache.level = level;
+	cache.maxDepth = maxDepth;
+	cache.dedup = dedup;
+	cache.built = false;
+	cache.tooLarge = false;
+	cache.beyond = NO_EXCESS;
+	cache.nodes.clear();
+	cache.states.clear();
+	cache.moves.clear();
+	cache.limits.clear();
+	cache.imageSets.clear();
+	cache.alternatives.clear();
+}
+
+// Find the nodes of the cache: every position cache.level moves from the
+// scramble, and every solved position on the way, that the moves and the
+// rules allow. The pruning tables don't leave anything out, unless it would
+// need more than MaxDepth; instead each node gets the least depth the search
+// gets there at. fixing are the symmetries that keep the scramble (see
+// parallelSolve).
+static void buildFrontier(FrontierCache& cache, unsigned char* state, int* coords, SearchContext& context, LimitCounts& limits, std::vector<int>& fixing){
+	CompiledPuzzle& puzzle = *context.puzzle;
+	int stateSize = puzzle.stateSize;
+	int nCoords = puzzle.coords.size();
+	int nMoves = puzzle.moves.size();
+	cache.built = true;
+
+	// moves that go past MaxDepth lower the excess of this copy, which is
+	// measured from MaxDepth instead of the depth being searched
+	SearchContext build = context;
+	build.excess = NO_EXCESS;
+
+	std::vector<SearchNode> level(1);
+	std::vector<int> bounds(1, frontierBound(state, coords, context));
+	level[0].state.assign(state, state + stateSize);
+	level[0].coords.assign(coords, coords + nCoords + 1);
+	level[0].limits = limits;
+	level[0].moveState = context.startState;
+	level[0].depth = cache.maxDepth;
+	if (bounds[0] > cache.maxDepth) {
+		cache.beyond = bounds[0];
+		return;
+	}
+
+	for (int l = 0; l < cache.level; l++) {
+		std::vector<SearchNode> next;
+		std::vector<int> nextBounds;
+		for (unsigned int n = 0; n < level.size(); n++) {
+			SearchNode& node = level[n];
+			if (isSolved(&node.state[0], *context.masks, stateSize))
+				addFrontierNode(cache, node, bounds[n], context);
+			context.nodes++;
+			SearchNode child;
+			child.state.resize(stateSize);
+			child.coords.resize(nCoords + 1);
+			for (int i = 0; i < nMoves; i++) {
+				if (l == 0 && !fixing.empty()) {
+					if (!smallestFirstMove(puzzle, fixing, i, child.images)) continue;
+				} else
+					child.images = node.images;
+				child.depth = tryMove(&node.state[0], &node.coords[0], &child.state[0], &child.coords[0], build, node.depth, node.limits, node.moveState, i);
+				if (child.depth < 0) continue;
+				int bound = std::max(bounds[n], cache.maxDepth - child.depth + frontierBound(&child.state[0], &child.coords[0], context));
+				if (bound > cache.maxDepth)
+					cache.beyond = std::min(cache.beyond, bound);
+				else {
+					child.limits = node.limits;
+					child.sequence = node.sequence;
+					child.sequence.push_back(i);
+					child.moveState = puzzle.automaton[node.moveState * nMoves + i];
+					next.push_back(child);
+					nextBounds.push_back(bound);
+				}
+				releaseMove(node.limits, *context.limits, i);
+			}
+			if (cache.nodes.size() + next.size() > (unsigned int)MAX_FRONTIER_NODES) {
+				initFrontierCache(cache, cache.level, cache.maxDepth, cache.dedup);
+				cache.built = true;
+				cache.tooLarge = true;
+				return;
+			}
+		}
+		level.swap(next);
+		bounds.swap(nextBounds);
+	}
+	if (build.excess != NO_EXCESS)
+		cache.beyond = std::min(cache.beyond, cache.maxDepth + build.excess);
+
+	// the same position, with the same moves left to do, only needs to be
+	// searched from once
+	std::map<std::string, int> seen;
+	for (unsigned int n = 0; n < level.size(); n++) {
+		if (!cache.dedup) {
+			addFrontierNode(cache, level[n], bounds[n], context);
+			continue;
+		}
+		SearchNode& node = level[n];
+		int fields[4] = { node.moveState, node.depth, bounds[n], imageSet(cache, node.images) };
+		std::string key((char*)&node.state[0], stateSize);
+		key.append((char*)fields, sizeof(fields));
+		if (context.limits->count > 0)
+			key.append((char*)node.limits.left, context.limits->count * sizeof(int));
+		std::map<std::string, int>::iterator found = seen.find(key);
+		if (found == seen.end()) {
+			seen[key] = cache.nodes.size();
+			addFrontierNode(cache, node, bounds[n], context);
+			continue;
+		}
+		FrontierNode& entry = cache.nodes[found->second];
+		if (entry.alternatives == -1) {
+			entry.alternatives = cache.alternatives.size();
+			cache.alternatives.push_back(std::vector<int>());
+		}
+		std::vector<int>& alternatives = cache.alternatives[entry.alternatives];
+		alternatives.insert(alternatives.end(), node.sequence.begin(), node.sequence.end());
+	}
+}
+
+// Add a node to the cache, whose search gets there at depth bound
+static void addFrontierNode(FrontierCache& cache, SearchNode& node, int bound, SearchContext& context){
+	FrontierNode entry;
+	entry.cost = cache.maxDepth - node.depth;
+	entry.bound = bound;
+	entry.length = node.sequence.size();
+	entry.moveState = node.moveState;
+	entry.images = imageSet(cache, node.images);
+	entry.alternatives = -1;
+	cache.nodes.push_back(entry);
+	cache.states.insert(cache.states.end(), node.state.begin(), node.state.end());
+	cache.moves.insert(cache.moves.end(), node.sequence.begin(), node.sequence.end());
+	cache.moves.resize(cache.nodes.size() * cache.level, -1);
+	if (context.limits->count > 0)
+		cache.limits.push_back(node.limits);
+}
+
+// The index of a list of images in cache.imageSets, adding it if it is new
+static int imageSet(FrontierCache& cache, std::vector<int>& images){
+	for (unsigned int k = 0; k < cache.imageSets.size(); k++)
+		if (cache.imageSets[k] == images)
+			return k;
+	cache.imageSets.push_back(images);
+	return cache.imageSets.size() - 1;
+}
+
+// The least depth the pruning tables let a position through at, looking up
+// the inverse position too if context.inverseSets is used
+static int frontierBound(unsigned char* state, int* coords, SearchContext& context){
+	CompiledPuzzle& puzzle = *context.puzzle;
+	int bound = pruneBound(state, coords, puzzle, *context.pruneOrder);
+	if (context.inverseSets != NULL) {
+		std::vector<unsigned char> inverse(puzzle.stateSize);
+		invertPosition(state, &inverse[0], puzzle, *context.inverseSets);
+		while (inverseCuts(&inverse[0], bound, puzzle, *context.inverseSets, NULL, NULL))
+			bound++;
+	}
+	return bound;
+}
+
+// The nodes of the cache the search gets to at this depth, with the depth
+// they have left. The others lower context.excess, like the nodes treeSolve
+// cuts off.
+static void cachedFrontier(FrontierCache& cache, SearchContext& context, int depth, std::vector<SearchNode>& frontier){
+	CompiledPuzzle& puzzle = *context.puzzle;
+	int stateSize = puzzle.stateSize;
+	int nCoords = puzzle.coords.size();
+	if (cache.beyond != NO_EXCESS)
+		noteExcess(context, cache.beyond - depth);
+	for (unsigned int n = 0; n < cache.nodes.size(); n++) {
+		FrontierNode& entry = cache.nodes[n];
+		if (entry.bound > depth) {
+			noteExcess(context, entry.bound - depth);
+			continue;
+		}
+		// solved positions before the cache's level are only there as solutions
+		if (entry.length < cache.level && entry.cost != depth)
+			continue;
+		SearchNode node;
+		node.state.assign(&cache.states[n * stateSize], &cache.states[n * stateSize] + stateSize);
+		node.coords.resize(nCoords + 1);
+		computeCoords(&node.state[0], puzzle, &node.coords[0]);
+		if (context.inverseSets != NULL) {
+			node.inverse.resize(stateSize);
+			invertPosition(&node.state[0], &node.inverse[0], puzzle, *context.inverseSets);
+		}
+		node.limits = cache.limits.empty() ? LimitCounts() : cache.limits[n];
+		node.sequence.assign(&cache.moves[n * cache.level], &cache.moves[n * cache.level] + entry.length);
+		node.images = cache.imageSets[entry.images];
+		if (entry.alternatives != -1)
+			node.alternatives = cache.alternatives[entry.alternatives];
+		node.moveState = entry.moveState;
+		node.depth = depth - entry.cost;
+		frontier.push_back(node);
+	}
+}
+
+#endif
@@ -22,7 +22,7 @@
 #ifndef GOD_H
 #define GOD_H
 
-static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, std::set<MovePair>& forbiddenPairs, Position& ignore, std::vector<Block>& blocks, int metric){
+static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, std::set<MovePair>& forbiddenPairs, Position& ignore, std::vector<Block>& blocks, CompiledPuzzle& puzzle, int metric){
 	// compute size of puzzle
 	// this pair<string,int> holds the piece set name and the type of data:
 	//		0 (orientation with parity constraint),
@@ -87,6 +87,7 @@ static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, st
 		using_blocks = false;
 	else
 		using_blocks = true;
+	std::vector<unsigned char> compiled(puzzle.stateSize); // the position being expanded, for blockLegal
 	
 	// try to initialize an array of sufficient size and set all to -1
 	int dataStructure = 0; // 0 = array, 1 = map<longlong,char>,
@@ -141,14 +142,51 @@ static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, st
 	// Loop through depths
 	if (dataStructure==0) {
 		while (1) {
+			// once there are fewer positions left to visit than at this depth, it
+			// is faster to look for them from the other side: a position not
+			// visited yet is at the next depth if a move takes it to one at this
+			// depth, as the inverse of that move takes it back. Blocks would have
+			// to be checked from the other side, so they are always done forwards.
+			long long visited = 0;
+			for (int d = 0; d < 128; d++)
+				visited += cnt[d];
+			if (puzzle.movesInvertible && !using_blocks && cnt[depth] > totalSize - visited) {
+				for (i=0; i<totalSize; i++) {
+					if (distance[i] != -1 && distance[i] <= depth + 1)
+						continue;
+					temp1 = unpackPosition(i, subSizes, datasets, solved);
+					for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++){
+						applyMove(temp1, temp2, moveIter->second.state, datasets);
+						if (distance[packPosition(temp2, subSizes, datasets)] != depth)
+							continue;
+						// the inverse of a move has the same QTM length
+						int newDepth = depth + ((metric == 0) ? 1 : moveIter->second.qtm);
+						if (distance[i] == -1 || distance[i] > newDepth) {
+							if (distance[i] != -1)
+								cnt[(int)distance[i]]--;
+							cnt[newDepth]++;
+							distance[i] = newDepth;
+						}
+						if (metric == 0)
+							break;
+					}
+				}
+				depth++;
+				if (cnt[depth] == 0) break;
+				std::cout << depth << "\t" << cnt[depth] << "\n";
+				continue;
+			}
+
 			// look for positions at this depth
 			for (i=0; i<totalSize; i++) {
 				if (distance[i] == depth) {
 					temp1 = unpackPosition(i, subSizes, datasets, solved);
 					// try all possible moves and see if that position hasn't been visited
+					if (using_blocks)
+						compilePosition(temp1, puzzle, &compiled[0]);
 					for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++){
 						if (using_blocks) // see if the blocks will prevent this move
-							if (!blockLegal(temp1, blocks, moveIter->second.state))
+							if (!blockLegal(&compiled[0], puzzle, puzzle.moves[puzzle.moveIndex[moveIter->first]]))
 								continue;
 					
 						// apply move and pack new position
@@ -163,6 +201,8 @@ static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, st
 						} else if (metric == 1) { // QTM
 							int newDepth = depth + moveIter->second.qtm;
 							if (distance[packTemp] == -1 || distance[packTemp] > newDepth) {
+								if (distance[packTemp] != -1)
+									cnt[(int)distance[packTemp]]--;
 								cnt[newDepth]++;
 								distance[packTemp] = newDepth;
 							}
@@ -185,9 +225,11 @@ static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, st
 					temp1 = unpackPosition(mapIter->first, subSizes, datasets, solved);
 					// try all possible moves and see if that position hasn't been visited
 					
+					if (using_blocks)
+						compilePosition(temp1, puzzle, &compiled[0]);
 					for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++){
 						if (using_blocks) // see if the blocks will prevent this move
-							if (!blockLegal(temp1, blocks, moveIter->second.state))
+							if (!blockLegal(&compiled[0], puzzle, puzzle.moves[puzzle.moveIndex[moveIter->first]]))
 								continue;
 					
 						// apply move and pack new position
@@ -226,9 +268,11 @@ static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, st
 				if (mapIter->second == depth) {
 					temp1 = unpackPosition2(mapIter->first, subSizes, datasets, solved);
 					// try all possible moves and see if that position hasn't been visited
+					if (using_blocks)
+						compilePosition(temp1, puzzle, &compiled[0]);
 					for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++){
 						if (using_blocks) // see if the blocks will prevent this move
-							if (!blockLegal(temp1, blocks, moveIter->second.state))
+							if (!blockLegal(&compiled[0], puzzle, puzzle.moves[puzzle.moveIndex[moveIter->first]]))
 								continue;
 					
 						// apply move and pack new position
@@ -294,9 +338,11 @@ static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, st
 					for (iter3 = solved.begin(); iter3 != solved.end(); iter3++){
 						nextPos[iter3->first] = newSubstate(iter3->second.size);
 					}
+					if (using_blocks)
+						compilePosition(curPos, puzzle, &compiled[0]);
 					for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++){
 						if (using_blocks) // see if the blocks will prevent this move
-							if (!blockLegal(curPos, blocks, moveIter->second.state))
+							if (!blockLegal(&compiled[0], puzzle, puzzle.moves[puzzle.moveIndex[moveIter->first]]))
 								continue;
 						
 						applyMove(curPos, nextPos, moveIter->second.state, datasets);
@@ -343,9 +389,11 @@ static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, st
 					for (iter3 = solved.begin(); iter3 != solved.end(); iter3++){
 						nextPos[iter3->first] = newSubstate(iter3->second.size);
 					}
+					if (using_blocks)
+						compilePosition(curPos, puzzle, &compiled[0]);
 					for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++){
 						if (using_blocks) // see if the blocks will prevent this move
-							if (!blockLegal(curPos, blocks, moveIter->second.state))
+							if (!blockLegal(&compiled[0], puzzle, puzzle.moves[puzzle.moveIndex[moveIter->first]]))
 								continue;
 						
 						applyMove(curPos, nextPos, moveIter->second.state, datasets);
@@ -393,9 +441,11 @@ static bool godTable(Position& solved, MoveList& moves, PieceTypes& datasets, st
 					for (iter3 = solved.begin(); iter3 != solved.end(); iter3++){
 						nextPos[iter3->first] = newSubstate(iter3->second.size);
 					}
+					if (using_blocks)
+						compilePosition(curPos, puzzle, &compiled[0]);
 					for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++){
 						if (using_blocks) // see if the blocks will prevent this move
-							if (!blockLegal(curPos, blocks, moveIter->second.state))
+							if (!blockLegal(&compiled[0], puzzle, puzzle.moves[puzzle.moveIndex[moveIter->first]]))
 								continue;
 						
 						applyMove(curPos, nextPos, moveIter->second.state, datasets);
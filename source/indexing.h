@@ -36,6 +36,15 @@ static int oVector2Index(int orientations[], int size, int omod) {
 	return tmp;
 }
 
+// Convert array of orientations (from a compiled state) into an index
+static int oVector2Index(unsigned char orientations[], int size, int omod) {
+	int tmp = 0;
+	for (int i = 0; i < size; i++){
+		tmp = tmp*omod + orientations[i];
+	}
+	return tmp;
+}
+
 // Convert array of orientations (with parity constraint) into an index
 static int oparVector2Index(int orientations[], int size, int omod) {
 	int tmp = 0;
@@ -96,6 +105,18 @@ static int pVector2Index(int permutation[], int size) {
 	return t;
 }
 
+// Convert permutation array (unique, from a compiled state) into an index
+static int pVector2Index(unsigned char permutation[], int size) {
+	int t = 0;
+	for (int i = 0; i < size - 1; i++){
+		t *= (size - i);
+		for (int j = i+1; j<size; j++)
+			if (permutation[i] > permutation[j])
+				t++;
+	}
+	return t;
+}
+
 // Convert index into a permutation array (unique)
 static int* pIndex2Array(int index, int size) {
 	int* permutation = new int[size];
@@ -155,6 +176,14 @@ static long long pVector3Index(int permutation[], unsigned int size) {
 	return index;
 }
 
+// Convert permutation array (non-unique, from a compiled state) into an index
+static long long pVector3Index(unsigned char permutation[], unsigned int size) {
+	int tmp[MAX_COMPILED_VALUE];
+	for (unsigned int i = 0; i < size; i++)
+		tmp[i] = permutation[i];
+	return pVector3Index(tmp, size);
+}
+
 // Convert index into a permutation array (non-unique)
 static int* pIndex3Array(long long index, std::vector<int> solved) {
 	return pIndex3Array(index, solved.data(), solved.size());
@@ -207,6 +236,112 @@ static int* pIndex3Array(long long index, int* solved, int size) {
 	return vec;
 }
 
+// Index of the coordinate of some pieces of a set (see JointPart): where the
+// tracked pieces are, with the others numbered other (more than any tracked
+// piece), ranked among all the ways to place them; then, if omod is more than
+// 1, the twists of the tracked pieces in the order of their slots. Piece
+// numbers may repeat.
+static long long subsetIndex(int permutation[], int orientation[], int size, std::vector<char>& tracked, int other, int omod) {
+	int mapped[MAX_COMPILED_VALUE];
+	int counts[MAX_COMPILED_VALUE + 2] = {0};
+	long long twists = 0;
+	long long orientations = 1;
+	for (int i = 0; i < size; i++) {
+		int p = permutation[i];
+		bool isTracked = (p > 0 && p < (int)tracked.size() && tracked[p]);
+		mapped[i] = isTracked ? p : other;
+		counts[mapped[i]]++;
+		if (isTracked && omod > 1) {
+			twists = twists * omod + orientation[i];
+			orientations *= omod;
+		}
+	}
+
+	long long comb = arrangements(counts, other);
+	long long index = 0;
+	int left = size;
+	for (int i = 0; i < size; i++) {
+		for (int v = 1; v < mapped[i]; v++)
+			if (counts[v] > 0)
+				index += comb * counts[v] / left;
+		comb = comb * counts[mapped[i]] / left;
+		counts[mapped[i]]--;
+		left--;
+	}
+	return index * orientations + twists;
+}
+
+// Convert a subsetIndex back into a permutation and orientation. solved is the
+// solved permutation with the pieces that aren't tracked numbered other.
+static void subsetPosition(long long index, std::vector<int>& solved, int other, int omod, int permutation[], int orientation[]) {
+	int size = solved.size();
+	int counts[MAX_COMPILED_VALUE + 2] = {0};
+	long long orientations = 1;
+	for (int i = 0; i < size; i++) {
+		counts[solved[i]]++;
+		if (solved[i] != other && omod > 1)
+			orientations *= omod;
+	}
+	long long twists = index % orientations;
+	index /= orientations;
+
+	long long comb = arrangements(counts, other);
+	int left = size;
+	for (int i = 0; i < size; i++) {
+		int v = 1;
+		for (;; v++) {
+			if (counts[v] == 0)
+				continue;
+			long long num = comb * counts[v] / left;
+			if (index < num)
+				break;
+			index -= num;
+		}
+		permutation[i] = v;
+		comb = comb * counts[v] / left;
+		counts[v]--;
+		left--;
+	}
+	for (int i = size - 1; i >= 0; i--) {
+		orientation[i] = 0;
+		if (permutation[i] != other && omod > 1) {
+			orientation[i] = twists % omod;
+			twists /= omod;
+		}
+	}
+}
+
+// Number of entries of a subsetIndex, or -1 if there are too many to count
+static long long subsetSize(std::vector<int>& solved, int other, int omod) {
+	int counts[MAX_COMPILED_VALUE + 2] = {0};
+	double estimate = 1;
+	for (unsigned int i = 0; i < solved.size(); i++) {
+		counts[solved[i]]++;
+		estimate *= (double)(i + 1) / counts[solved[i]];
+		if (solved[i] != other)
+			estimate *= omod;
+	}
+	if (estimate > 1e15)
+		return -1;
+	long long size = arrangements(counts, other);
+	for (unsigned int i = 0; i < solved.size(); i++)
+		if (solved[i] != other)
+			size *= omod;
+	return size;
+}
+
+// Number of ways to arrange pieces with counts[v] of each number v from 1 to values
+static long long arrangements(int counts[], int values) {
+	long long comb = 1;
+	int n = 0;
+	for (int v = 1; v <= values; v++)
+		for (int j = 1; j <= counts[v]; j++) {
+			n++;
+			comb = comb * n / j;
+		}
+	return comb;
+}
+
 static long long combinations(std::vector<int> vec) {
 	return combinations(vec.data(), vec.size());
 }
@@ -258,6 +393,18 @@ static std::vector<long long> packVector(int vec[], int size){
 	return result;
 }
 
+static std::vector<long long> packVector(unsigned char vec[], int size){
+	std::vector<long long> result (1 + size/8);
+	
+	for (int i = 0; i < size; i += 8) {
+		long long element = 0;
+		for (int j = 0; j < 8; j++)
+			if (i+j < size) element += ((long long)vec[i+j]) << (8*j);
+		result[i/8] = element;
+	}
+	return result;
+}
+
 static std::vector<int> unpackVector(std::vector<long long> vec){
 	unsigned int size = vec.size();
 	std::vector<int> result (8*size);
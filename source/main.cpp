@@ -31,9 +31,13 @@
 #include <string>
 #include <vector>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 struct ksolve {
 	#include "data.h"
@@ -41,8 +45,16 @@ struct ksolve {
 	#include "blocks.h"
 	#include "checks.h"
 	#include "indexing.h"
+	#include "compile.h"
+	#include "symmetry.h"
 	#include "pruning.h"
+	#include "sink.h"
+	#include "stats.h"
+	#include "transposition.h"
 	#include "search.h"
+	#include "frontier.h"
+	#include "mitm.h"
+	#include "phases.h"
 	#include "readdef.h"
 	#include "readscramble.h"
 	#include "god.h"
@@ -51,29 +63,124 @@ struct ksolve {
 
 		srand(time(NULL)); // initialize RNG in case we need it
 
-		if (argc != 3){
+		// read options, which come before the file names
+		Options options;
+		int arg = 1;
+		while (arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+			string option(argv[arg]);
+			if (option == "--batch" || option == "--stats" || option == "--inverse" || option == "--frontier-dedup") {
+				if (option == "--batch")
+					options.batch = true;
+				else if (option == "--stats")
+					options.stats = true;
+				else if (option == "--frontier-dedup")
+					options.frontierDedup = true;
+				else
+					options.inversePruning = true;
+				arg++;
+				continue;
+			}
+			if (arg + 1 >= argc) {
+				std::cerr << "Missing value for option " << option << ".\n";
+				return EXIT_FAILURE;
+			}
+			string text(argv[arg + 1]);
+			int value = atoi(text.c_str());
+			if (option == "--threads") {
+				if (value < 1) {
+					std::cerr << "Number of threads must be at least 1.\n";
+					return EXIT_FAILURE;
+				}
+				options.threads = value;
+			} else if (option == "--split-depth") {
+				if (value < 0) {
+					std::cerr << "Split depth can't be negative.\n";
+					return EXIT_FAILURE;
+				}
+				options.splitDepth = value;
+			} else if (option == "--tt-size") {
+				if (value < 0) {
+					std::cerr << "Transposition table size can't be negative.\n";
+					return EXIT_FAILURE;
+				}
+				options.tableSize = value;
+			} else if (option == "--frontier") {
+				if (value < 0) {
+					std::cerr << "Frontier depth can't be negative.\n";
+					return EXIT_FAILURE;
+				}
+				options.frontierDepth = value;
+			} else if (option == "--prune-order") {
+				if (text == "fixed")
+					options.pruneOrder = PRUNE_ORDER_FIXED;
+				else if (text == "table")
+					options.pruneOrder = PRUNE_ORDER_TABLE;
+				else if (text == "adaptive")
+					options.pruneOrder = PRUNE_ORDER_ADAPTIVE;
+				else {
+					std::cerr << "Prune order must be fixed, table or adaptive.\n";
+					return EXIT_FAILURE;
+				}
+			} else if (option == "--output") {
+				if (text == "text")
+					options.output = OUTPUT_TEXT;
+				else if (text == "json")
+					options.output = OUTPUT_JSON;
+				else if (text == "count")
+					options.output = OUTPUT_COUNT;
+				else {
+					std::cerr << "Output must be text, json or count.\n";
+					return EXIT_FAILURE;
+				}
+			} else {
+				std::cerr << "Unknown option " << option << ".\n";
+				return EXIT_FAILURE;
+			}
+			arg += 2;
+		}
+
+		if (argc - arg != 2){
 			std::cerr << "ksolve+ v1.3a - Linux Port by Matt Stiefel\n";
 			std::cerr << "(c) 2007-2013 by Kare Krig and Michael Gottlieb\n";
-			std::cerr << "Usage: ksolve [def-file] [scramble-file]\n";
+			std::cerr << "Usage: ksolve [options] [def-file] [scramble-file]\n";
+			std::cerr << "Options:\n";
+			std::cerr << "  --threads n      search with n threads (default: all cores)\n";
+			std::cerr << "  --split-depth n  split the top n moves of the tree between threads\n";
+			std::cerr << "                   (default: split as deep as needed to keep threads busy)\n";
+			std::cerr << "  --tt-size n      use n megabytes to remember positions with no solution\n";
+			std::cerr << "                   (default: 0, none)\n";
+			std::cerr << "  --output type    print solutions as text (default), json or count\n";
+			std::cerr << "  --batch          solve many scrambles at once, one thread each\n";
+			std::cerr << "  --stats          print what the search did at each depth\n";
+			std::cerr << "  --prune-order o  look at the pruning tables in a fixed order, the order\n";
+			std::cerr << "                   their values suggest (table, default) or adaptive\n";
+			std::cerr << "  --inverse        look up the inverse position in the orientation tables too\n";
+			std::cerr << "  --frontier n     keep the positions n moves from the scramble between depths\n";
+			std::cerr << "                   (default: 0, search from the scramble each time)\n";
+			std::cerr << "  --frontier-dedup keep each of those positions once\n";
 			std::cerr << "See readme for additional help.\n";
 			return EXIT_FAILURE;
 		}
 
+#ifdef _OPENMP
+		if (options.threads > 0)
+			omp_set_num_threads(options.threads);
+#endif
 
-		std::ifstream definitionStream(argv[1]);
+		std::ifstream definitionStream(argv[arg]);
 		if (!definitionStream.good()){
 			std::cout << "Can't open definition file!\n";
 			exit(-1);
 		}
-		std::ifstream scrambleStream(argv[2]);
+		std::ifstream scrambleStream(argv[arg + 1]);
 		if (!scrambleStream.good()){
 			std::cout << "Can't open scramble file!\n";
 			exit(-1);
 		}
 
-		string defFileName(argv[1]);
-		string scrambleFileName(argv[2]);
-		return ksolveWrapped(definitionStream, scrambleStream, defFileName, scrambleFileName, true);
+		string defFileName(argv[arg]);
+		string scrambleFileName(argv[arg + 1]);
+		return ksolveWrapped(definitionStream, scrambleStream, defFileName, scrambleFileName, true, options);
 
 	}
 
@@ -81,7 +188,9 @@ struct ksolve {
 													 std::istream &scrambleStream,
 													 string defFileName,
 													 string scrambleFileName,
-													 bool usePruneTable)
+													 bool usePruneTable,
+													 Options options = Options(),
+													 SolutionSink* sink = NULL)
 	{
 
 		clock_t start;
@@ -93,8 +202,10 @@ struct ksolve {
 		Position solved = ruleset.getSolved();
 		MoveList moves = ruleset.getMoves();
 		std::set<MovePair> forbidden = ruleset.getForbiddenPairs();
+		std::set<MovePair> commuting = ruleset.getCommutingPairs();
 		Position ignore = ruleset.getIgnore();
 		std::vector<Block> blocks = ruleset.getBlocks();
+		JointTables joints = ruleset.getJointTables();
 		std::cout << "Ruleset loaded.\n";
 
 		// Print all generated moves
@@ -110,98 +221,352 @@ struct ksolve {
 		}
 		std::cout << ".\n";
 
+		// The search works on a flat, compiled version of the puzzle
+		CompiledPuzzle puzzle = compilePuzzle(datasets, solved, moves, blocks, forbidden, commuting);
+
+		// Symmetries make the partial pruning tables smaller
+		std::vector<unsigned char> defIgnore = compileIgnore(ignore, puzzle);
+		findSymmetries(puzzle, defIgnore, forbidden, commuting);
+		if (puzzle.symmetries.size() > 1)
+			std::cout << "Found " << puzzle.symmetries.size() << " symmetries.\n";
+
 		// Compute or load the pruning tables
 		PruneTable tables;
-		tables = getCompletePruneTables(solved, moves, datasets, ignore, defFileName, usePruneTable);
+		std::vector<int> htmCosts;
+		tables = getCompletePruneTables(solved, moves, datasets, ignore, defFileName, usePruneTable, puzzle, htmCosts, "", joints);
 		std::cout << "Pruning tables loaded.\n";
 
 		//datasets = updateDatasets(datasets, tables);
 		updateDatasets(datasets, tables);
+		attachTables(puzzle, datasets, tables, joints);
+		estimatePruneRates(puzzle);
+		compileInverses(puzzle, defIgnore);
 
 		// God's Algorithm tables
 		std::string godHTM = "!";
 		std::string godQTM = "!q";
 		if (0==godHTM.compare(scrambleFileName)) {
 			std::cout << "Computing God's Algorithm tables (HTM)\n";
-			godTable(solved, moves, datasets, forbidden, ignore, blocks, 0);
+			godTable(solved, moves, datasets, forbidden, ignore, blocks, puzzle, 0);
 			std::cout << "Time: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s\n";
 			return EXIT_SUCCESS;
 		} else if (0==godQTM.compare(scrambleFileName)) {
 			std::cout << "Computing God's Algorithm tables (QTM)\n";
-			godTable(solved, moves, datasets, forbidden, ignore, blocks, 1);
+			godTable(solved, moves, datasets, forbidden, ignore, blocks, puzzle, 1);
 			std::cout << "Time: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s\n";
 			return EXIT_SUCCESS;
 		}
 
+		// The transposition table is shared by all scrambles, but emptied for each one
+		TranspositionTable table;
+		if (options.tableSize > 0 && !options.batch)
+			initTranspositionTable(table, puzzle, options.tableSize);
+
 		// Load the scramble to be solved
 		Scramble states(scrambleStream, solved, moves, datasets, blocks);
 		std::cout << "Scrambles loaded.\n";
 
-		ScrambleDef scramble = states.getScramble();
+		// Metrics other than HTM get pruning tables of their own, compiled in
+		// place as they must not be copied
+		std::vector<std::map<int, int> > metricCosts = states.getMetrics();
+		compileMetrics(puzzle, metricCosts);
+		std::vector<CompiledMetric> metrics(metricCosts.size());
+		std::vector<CompiledPuzzle*> puzzles(metricCosts.size(), &puzzle);
+		for (unsigned int k = 1; k < metricCosts.size(); k++) {
+			compileMetric(metrics[k], k, puzzle, solved, moves, datasets, ignore, defIgnore, defFileName, usePruneTable, joints);
+			puzzles[k] = &metrics[k].puzzle;
+		}
 
-		while(scramble.state.size() != 0){
-			int depth = 0;
-			string temp_a, temp_b;
-			temp_a = " ";
-
-			std::cout << "\nSolving " << scramble.name.c_str() << "\n";
-
-			if (scramble.printState == 1) {
-				std::cout << "Scramble position:\n";
-				printPosition(scramble.state);
-			}
-
-			// give out a warning if we have some undefined permutations on a bandaged puzzle
-			if (blocks.size() != 0) {
-				bool hasUndefined = false;
-				Position::iterator iter;
-				for (iter = scramble.state.begin(); iter != scramble.state.end(); iter++) {
-					int setsize = iter->second.size;
-					for (int i = 0; i < setsize; i++) {
-						if (iter->second.permutation[i] == -1) {
-							hasUndefined = true;
-						}
-					}
-				}
-				if (hasUndefined) {
-					std::cout << "Warning: using blocks, but scramble has unknown (?) permutations!\n";
-				}
+		// Phases get their own pruning tables. They are compiled in place, as
+		// they must not be copied.
+		std::vector<std::vector<PhaseDef> > phaseDefs = states.getPhases();
+		std::vector<std::vector<CompiledPhase> > phases(phaseDefs.size());
+		for (unsigned int p = 0; p < phaseDefs.size(); p++) {
+			phases[p].resize(phaseDefs[p].size());
+			for (unsigned int k = 0; k < phaseDefs[p].size(); k++)
+				compilePhase(phaseDefs[p][k], phases[p][k], puzzle, solved, moves, datasets, ignore, tables);
+		}
+
+		if (options.batch && sink == NULL) {
+			if (options.tableSize > 0)
+				std::cout << "The transposition table is not used in batch mode.\n";
+			solveBatch(states, puzzles, moves, blocks, phases, options);
+		} else {
+			// Where the solutions go, unless the caller has its own sink
+			SolutionSink* ownSink = NULL;
+			if (sink == NULL) {
+				ownSink = newSink(options, searchThreads(), std::cout);
+				sink = ownSink;
 			}
 
-			// get rid of any moves that are zeroed out in moveLimits
-			// and set .limited for each move
-			MoveList moves2;
-			MoveList::iterator iter2;
-			for (iter2 = moves.begin(); iter2 != moves.end(); iter2++){
-				moves2[iter2->first] = iter2->second;
+			ScrambleDef scramble = states.getScramble();
+			while(scramble.state.size() != 0){
+				solveScramble(scramble, *puzzles[scramble.metric], moves, blocks, (scramble.phases >= 0) ? &phases[scramble.phases] : NULL, (options.tableSize > 0) ? &table : NULL, options, sink, searchThreads(), std::cout);
+				scramble = states.getScramble();
 			}
-			processMoveLimits(moves2, scramble.moveLimits);
 
-			std::cout << "Depth 0\n";
+			delete ownSink;
+		}
 
-			// The tree-search for the solution(s)
-			int usedSlack = 0;
-			while(1) {
-				bool foundSolution = treeSolve(scramble.state, solved, moves, datasets, tables, forbidden, scramble.ignore, blocks, depth, scramble.metric, scramble.moveLimits, temp_a, -1, true);
-				if (foundSolution || usedSlack > 0) {
-					usedSlack++;
-					if (usedSlack > scramble.slack) break;
+		std::cout << "Time: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s\n";
+
+		return EXIT_SUCCESS;
+	}
+
+	// Solve one scramble, writing everything about it to out. threads is the
+	// number of threads the search uses; phases are the phases the scramble is
+	// solved in, or NULL.
+	static void solveScramble(ScrambleDef& scramble, CompiledPuzzle& puzzle, MoveList& moves, std::vector<Block>& blocks, std::vector<CompiledPhase>* phases, TranspositionTable* table, Options& options, SolutionSink* sink, int threads, std::ostream& out) {
+		int depth = 0;
+
+		out << "\nSolving " << scramble.name.c_str() << "\n";
+
+		if (scramble.printState == 1) {
+			out << "Scramble position:\n";
+			printPosition(scramble.state, out);
+		}
+
+		// give out a warning if we have some undefined permutations on a bandaged puzzle
+		if (blocks.size() != 0) {
+			bool hasUndefined = false;
+			Position::iterator iter;
+			for (iter = scramble.state.begin(); iter != scramble.state.end(); iter++) {
+				int setsize = iter->second.size;
+				for (int i = 0; i < setsize; i++) {
+					if (iter->second.permutation[i] == -1) {
+						hasUndefined = true;
+					}
 				}
-				depth++;
-				if (depth > scramble.max_depth){
-					std::cout << "\nMax depth reached, aborting.\n";
-					break;
+			}
+			if (hasUndefined) {
+				out << "Warning: using blocks, but scramble has unknown (?) permutations!\n";
+			}
+		}
+
+		// get rid of any moves that are zeroed out in moveLimits
+		// and set .limited for each move
+		MoveList moves2;
+		MoveList::iterator iter2;
+		for (iter2 = moves.begin(); iter2 != moves.end(); iter2++){
+			moves2[iter2->first] = iter2->second;
+		}
+		processMoveLimits(moves2, scramble.moveLimits);
+
+		sink->startScramble(puzzle, scramble.name);
+		if (phases != NULL) {
+			solvePhases(scramble, *phases, puzzle, options, sink, out);
+			sink->endScramble();
+			out << "\n";
+			return;
+		}
+		out << "Depth 0\n";
+
+		// compile the scramble and what it ignores
+		std::vector<unsigned char> state(puzzle.stateSize);
+		compilePosition(scramble.state, puzzle, &state[0]);
+		std::vector<unsigned char> ignoreMask = compileIgnore(scramble.ignore, puzzle);
+
+		// The tree-search for the solution(s)
+		SearchContext context;
+		context.puzzle = &puzzle;
+		context.ignore = &ignoreMask;
+		IgnoreMasks masks;
+		compileIgnoreMasks(ignoreMask, puzzle, masks);
+		context.masks = &masks;
+		std::vector<std::vector<int> > pruneOrder;
+		orderPruningTables(puzzle, options.pruneOrder, masks.skip, pruneOrder);
+		context.pruneOrder = &pruneOrder;
+		context.metric = scramble.metric;
+		context.startState = 0;
+		context.minCost = minMoveCost(puzzle, scramble.metric);
+		context.images = NULL;
+		context.alternatives = NULL;
+		context.prefixLength = 0;
+		SearchControl control;
+		control.solutions = 0;
+		control.maxSolutions = scramble.maxSolutions;
+		control.nodes = 0;
+		control.nodeLimit = scramble.nodeLimit;
+		control.startTime = wallTime();
+		control.timeLimit = scramble.timeLimit;
+		control.outOfNodes = false;
+		control.outOfTime = false;
+		control.cancelled = false;
+		context.sink = sink;
+		context.control = &control;
+		CompiledLimits limits;
+		LimitCounts limitCounts;
+		compileLimits(scramble.moveLimits, puzzle, ignoreMask, limits, limitCounts);
+		context.limits = &limits;
+		context.sequence = NULL;
+		context.thread = 0;
+		context.table = table;
+		if (table != NULL)
+			clearTranspositionTable(*table);
+		context.nodes = 0;
+		context.tableHits = 0;
+		context.tableMisses = 0;
+		SearchStats stats;
+		context.stats = (options.stats || options.pruneOrder == PRUNE_ORDER_ADAPTIVE) ? &stats : NULL;
+		std::vector<long long> threadNodes(threads, 0);
+		std::vector<int> coords(puzzle.coords.size() + 1);
+		computeCoords(&state[0], puzzle, &coords[0]);
+
+		// the inverse position, to look up in the orientation tables too
+		std::vector<int> invertible;
+		std::vector<unsigned char> inverse(puzzle.stateSize);
+		if (options.inversePruning) {
+			invertible = inverseSets(&state[0], ignoreMask, puzzle);
+			if (invertible.empty())
+				out << "Inverse pruning can't be used for this scramble.\n";
+			else
+				invertPosition(&state[0], &inverse[0], puzzle, invertible);
+		}
+		context.inverseSets = invertible.empty() ? NULL : &invertible;
+		MitmKeyRules keyRules;
+		bool useMitm = (scramble.searchMode == SEARCH_MODE_MITM && mitmUsable(puzzle, scramble, ignoreMask, keyRules, out));
+		// the top of the tree, kept between depths
+		FrontierCache frontierCache;
+		FrontierCache* cache = NULL;
+		if (options.frontierDepth > 0) {
+			initFrontierCache(frontierCache, options.frontierDepth, scramble.max_depth, options.frontierDedup);
+			cache = &frontierCache;
+		}
+		int solutionDepth = -1; // where the first solution was found
+		while(1) {
+			bool foundSolution = false;
+			long long nodesBefore = totalNodes(context, threadNodes);
+			double timeBefore = wallTime();
+			if (context.stats != NULL)
+				clearStats(stats, puzzle);
+			if (useMitm) {
+				bool complete;
+				foundSolution = mitmSolve(&state[0], &coords[0], context, depth, keyRules, complete);
+				context.excess = 1; // not tracked by the meet in the middle search
+				if (!complete) {
+					out << "Too many positions for meet in the middle, using tree search.\n";
+					useMitm = false;
 				}
-				std::cout << "Depth " << depth << "\n";
 			}
-			std::cout << "\n";
+			if (!useMitm) {
+				bool building = (cache != NULL && !cache->built);
+				foundSolution = parallelSolve(&state[0], invertible.empty() ? NULL : &inverse[0], &coords[0], context, depth, limitCounts, options, threadNodes, cache);
+				if (building && cache->tooLarge) {
+					out << "Too many positions for the frontier cache, searching from the scramble.\n";
+					cache = NULL;
+				} else if (building)
+					out << "Frontier cache: " << cache->nodes.size() << " positions.\n";
+			}
+			if (options.stats)
+				printStats(stats, puzzle, totalNodes(context, threadNodes) - nodesBefore, wallTime() - timeBefore, out);
+			if (options.pruneOrder == PRUNE_ORDER_ADAPTIVE)
+				adaptPruningOrder(puzzle, stats, pruneOrder);
+			// a depth the budget cut short can still have found solutions
+			if (foundSolution && solutionDepth < 0)
+				solutionDepth = depth;
+			if (control.outOfNodes || control.outOfTime) {
+				reportBudget(control, depth, solutionDepth, out);
+				break;
+			}
+			if (control.cancelled) {
+				out << "\nSolution limit reached, stopping.\n";
+				break;
+			}
+			if (context.excess == NO_EXCESS) {
+				out << "\nThe whole search tree was searched, so a deeper search finds nothing new.\n";
+				break;
+			}
 
-			scramble = states.getScramble();
+			// no node got within this much of the next depths, so they can't
+			// have solutions
+			int next = depth + context.excess;
+			if (solutionDepth >= 0 && next > solutionDepth + scramble.slack)
+				break;
+			for (depth++; depth < next && depth <= scramble.max_depth; depth++)
+				out << "Depth " << depth << " skipped, no solution can end there\n";
+			if (depth > scramble.max_depth){
+				out << "\nMax depth reached, aborting.\n";
+				break;
+			}
+			// the threads only count their nodes now and then, so recount them
+			control.nodes = totalNodes(context, threadNodes);
+			checkBudget(control, 0);
+			if (control.outOfNodes || control.outOfTime) {
+				reportBudget(control, depth, solutionDepth, out);
+				break;
+			}
+			out << "Depth " << depth << "\n";
 		}
 
-		std::cout << "Time: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s\n";
+		sink->endScramble();
 
-		return EXIT_SUCCESS;
+		// nodes visited, in total and by each thread
+		out << "Nodes: " << totalNodes(context, threadNodes);
+		if (threadNodes.size() > 1) {
+			out << " (threads:";
+			for (unsigned int t = 0; t < threadNodes.size(); t++)
+				out << " " << threadNodes[t];
+			out << ")";
+		}
+		out << "\n";
+		if (context.table != NULL)
+			out << "Transposition table: " << context.tableHits << " hits, " << context.tableMisses << " misses\n";
+		out << "\n";
+	}
+
+	// Solve all the scrambles at the same time, one thread each, starting with the
+	// ones the pruning tables say are furthest from solved. The output of each
+	// scramble is collected and printed in the order of the scramble file.
+	static void solveBatch(Scramble& states, std::vector<CompiledPuzzle*>& puzzles, MoveList& moves, std::vector<Block>& blocks, std::vector<std::vector<CompiledPhase> >& phases, Options& options) {
+		std::vector<ScrambleDef> scrambles;
+		ScrambleDef scramble = states.getScramble();
+		while(scramble.state.size() != 0){
+			scrambles.push_back(scramble);
+			scramble = states.getScramble();
+		}
+		int count = scrambles.size();
+
+		// longest expected first, ties in file order
+		std::vector<std::pair<int, int> > order;
+		for (int n = 0; n < count; n++) {
+			CompiledPuzzle& puzzle = *puzzles[scrambles[n].metric];
+			std::vector<unsigned char> state(puzzle.stateSize);
+			compilePosition(scrambles[n].state, puzzle, &state[0]);
+			std::vector<int> coords(puzzle.coords.size() + 1);
+			computeCoords(&state[0], puzzle, &coords[0]);
+			std::vector<unsigned char> ignoreMask = compileIgnore(scrambles[n].ignore, puzzle);
+			IgnoreMasks masks;
+			compileIgnoreMasks(ignoreMask, puzzle, masks);
+			std::vector<std::vector<int> > pruneOrder;
+			orderPruningTables(puzzle, options.pruneOrder, masks.skip, pruneOrder);
+			order.push_back(std::make_pair(-pruneBound(&state[0], &coords[0], puzzle, pruneOrder), n));
+		}
+		std::sort(order.begin(), order.end());
+
+		std::vector<string> results(count);
+		std::vector<char> done(count, 0);
+		int printed = 0;
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (int k = 0; k < count; k++) {
+			int n = order[k].second;
+			std::ostringstream out;
+			SolutionSink* sink = newSink(options, 1, out);
+			solveScramble(scrambles[n], *puzzles[scrambles[n].metric], moves, blocks, (scrambles[n].phases >= 0) ? &phases[scrambles[n].phases] : NULL, NULL, options, sink, 1, out);
+			delete sink;
+
+			// print everything that is done, up to the first scramble that isn't
+			#pragma omp critical (batchOutput)
+			{
+				results[n] = out.str();
+				done[n] = 1;
+				while (printed < count && done[printed]) {
+					std::cout << results[printed];
+					results[printed].clear();
+					printed++;
+				}
+				std::cout.flush();
+			}
+		}
 	}
 };
 
@@ -0,0 +1,255 @@
+/*
+ KSolve+ - Puzzle solving program.
+ Copyright (C) 2007-2013 Kre Krig and Michael Gottlieb
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Functions for the meet in the middle search
+
+#ifndef MITM_H
+#define MITM_H
+
+// Can this scramble be searched by meeting in the middle? Prints why not if it can't.
+static bool mitmUsable(CompiledPuzzle& puzzle, ScrambleDef& scramble, std::vector<unsigned char>& ignore, MitmKeyRules& rules, std::ostream& out){
+	if (puzzle.blocks.size() != 0 || scramble.moveLimits.size() != 0) {
+		out << "Meet in the middle can't be used with blocks or move limits, using tree search.\n";
+		return false;
+	}
+	if (!mitmKeyRules(puzzle, ignore, rules)) {
+		out << "Meet in the middle can't handle what this scramble ignores, using tree search.\n";
+		return false;
+	}
+	return true;
+}
+
+// Work out how ignored pieces are left out of the positions we match. Ignored
+// slots can hold any of the pieces that are ignored in the solved state, so those
+// pieces all become 0; this only works if they are not also needed elsewhere.
+static bool mitmKeyRules(CompiledPuzzle& puzzle, std::vector<unsigned char>& ignore, MitmKeyRules& rules){
+	rules.merge.clear();
+	rules.wild.clear();
+	if (ignore.empty())
+		return true;
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		std::vector<char> merge (MAX_COMPILED_VALUE + 1, 0);
+		std::vector<char> wild (MAX_COMPILED_VALUE + 1, 0);
+		std::vector<char> kept (MAX_COMPILED_VALUE + 1, 0);
+		int zeroWild = -1;
+		for (int i = 0; i < set.size; i++) {
+			int piece = puzzle.solved[set.poffset + i];
+			char orientationIgnored = ignore[set.ooffset + i];
+			if (ignore[set.poffset + i]) {
+				merge[piece] = 1;
+				if (zeroWild != -1 && zeroWild != orientationIgnored)
+					return false;
+				zeroWild = orientationIgnored;
+			} else {
+				if (kept[piece] && wild[piece] != orientationIgnored)
+					return false;
+				kept[piece] = 1;
+				wild[piece] = orientationIgnored;
+			}
+		}
+		for (int p = 1; p <= MAX_COMPILED_VALUE; p++)
+			if (merge[p] && kept[p])
+				return false;
+		wild[0] = (zeroWild == 1);
+		rules.merge.push_back(merge);
+		rules.wild.push_back(wild);
+	}
+	return true;
+}
+
+// The part of a position that has to match, packed
+static std::vector<long long> mitmKey(unsigned char* state, CompiledPuzzle& puzzle, MitmKeyRules& rules){
+	if (rules.merge.empty())
+		return packVector(state, puzzle.stateSize);
+	std::vector<unsigned char> key (state, state + puzzle.stateSize);
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		for (int i = 0; i < set.size; i++) {
+			int piece = state[set.poffset + i];
+			if (rules.merge[s][piece])
+				piece = 0;
+			key[set.poffset + i] = piece;
+			if (rules.wild[s][piece])
+				key[set.ooffset + i] = 255;
+		}
+	}
+	return packVector(&key[0], puzzle.stateSize);
+}
+
+// The move that undoes move
+static compiledmove invertMove(compiledmove& move, CompiledPuzzle& puzzle){
+	compiledmove inverse = move;
+	for (int i = 0; i < puzzle.stateSize; i++) {
+		int from = move.source[i];
+		inverse.source[from] = i;
+		inverse.twist[from] = (puzzle.modulus[i] - move.twist[i]) % puzzle.modulus[i];
+	}
+	return inverse;
+}
+
+// Search for the solutions of exactly this depth by meeting in the middle. Every
+// position half way from the scramble is stored, then moves are undone from the
+// solved state until one of the stored positions turns up. Sets complete to
+// false (and finds nothing) if too many positions would have to be stored, and
+// finds nothing if the search runs out of nodes or time.
+static bool mitmSolve(unsigned char* state, int* coords, SearchContext& context, int depth, MitmKeyRules& rules, bool& complete){
+	CompiledPuzzle& puzzle = *context.puzzle;
+	int stateSize = puzzle.stateSize;
+	int nCoords = puzzle.coords.size();
+	int nMoves = puzzle.moves.size();
+	int half = (depth + 1) / 2;
+	complete = true;
+
+	// positions from the scramble, up to the first move that gets half way
+	std::vector<MitmNode> nodes;
+	std::map<std::vector<long long>, std::vector<int> > index;
+	MitmNode root;
+	root.parent = -1;
+	root.move = -1;
+	root.cost = 0;
+	root.moveState = 0;
+	nodes.push_back(root);
+	std::vector<unsigned char> buffer((depth + 2) * stateSize);
+	std::vector<int> coordBuffer((depth + 2) * nCoords + 1);
+	memcpy(&buffer[0], state, stateSize);
+	memcpy(&coordBuffer[0], coords, nCoords * sizeof(int));
+	LimitCounts noLimits;
+	mitmForward(&buffer[0], &coordBuffer[0], context, depth, half, 0, nodes, index, rules, noLimits, complete);
+	if (!complete || context.control->cancelled)
+		return false;
+
+	// undo moves from the solved state, and look up what we reach
+	std::vector<compiledmove> inverses;
+	for (int m = 0; m < nMoves; m++)
+		inverses.push_back(invertMove(puzzle.moves[m], puzzle));
+	std::vector<unsigned char> back((depth - half + 2) * stateSize);
+	memcpy(&back[0], &puzzle.solved[0], stateSize);
+	std::vector<int> suffix;
+	std::vector<std::vector<int> > solutions;
+	mitmBackward(&back[0], context, depth, half, 0, suffix, inverses, nodes, index, rules, solutions);
+	if (context.control->cancelled)
+		return false;
+
+	// hand them over in the order the tree search would find them
+	std::sort(solutions.begin(), solutions.end());
+	for (unsigned int n = 0; n < solutions.size() && claimSolution(*context.control); n++) {
+		context.sink->found(0, solutions[n].empty() ? NULL : &solutions[n][0], solutions[n].size());
+		if (context.stats != NULL)
+			context.stats->solutions++;
+	}
+	context.sink->flush(0);
+	return !solutions.empty();
+}
+
+// Store the positions that are half way from the scramble, under the key they
+// have to match. node is the index in nodes of the current position.
+static void mitmForward(unsigned char* state, int* coords, SearchContext& context, int depth, int half, int node, std::vector<MitmNode>& nodes, std::map<std::vector<long long>, std::vector<int> >& index, MitmKeyRules& rules, LimitCounts& noLimits, bool& complete){
+	CompiledPuzzle& puzzle = *context.puzzle;
+	if (context.control->cancelled)
+		return;
+	context.nodes++;
+	if (context.nodes % BUDGET_CHECK_NODES == 0)
+		checkBudget(*context.control, BUDGET_CHECK_NODES);
+	int pruned = pruningTable(state, coords, depth, puzzle, *context.pruneOrder, (context.stats != NULL) ? &context.stats->checked[0] : NULL, NULL);
+	if (pruned >= 0) {
+		if (context.stats != NULL)
+			context.stats->pruned[pruned]++;
+		return;
+	}
+	int cost = nodes[node].cost;
+	int moveState = nodes[node].moveState;
+	if (cost >= half) {
+		index[mitmKey(state, puzzle, rules)].push_back(node);
+		return;
+	}
+
+	unsigned char* new_state = state + puzzle.stateSize;
+	int* new_coords = coords + puzzle.coords.size();
+	int nMoves = puzzle.moves.size();
+	for (int i = 0; i < nMoves; i++) {
+		int newDepth = tryMove(state, coords, new_state, new_coords, context, depth, noLimits, moveState, i);
+		if (newDepth < 0) continue;
+		if (nodes.size() >= (unsigned int)MAX_MITM_NODES) {
+			complete = false;
+			return;
+		}
+		MitmNode child;
+		child.parent = node;
+		child.move = i;
+		child.cost = cost + depth - newDepth;
+		child.moveState = puzzle.automaton[moveState * nMoves + i];
+		nodes.push_back(child);
+		mitmForward(new_state, new_coords, context, newDepth, half, nodes.size() - 1, nodes, index, rules, noLimits, complete);
+		if (!complete)
+			return;
+	}
+}
+
+// Undo moves from the solved state. suffix holds the moves undone so far, the
+// last one undone (the first one of the solution's second half) at the back.
+static void mitmBackward(unsigned char* state, SearchContext& context, int depth, int half, int cost, std::vector<int>& suffix, std::vector<compiledmove>& inverses, std::vector<MitmNode>& nodes, std::map<std::vector<long long>, std::vector<int> >& index, MitmKeyRules& rules, std::vector<std::vector<int> >& solutions){
+	CompiledPuzzle& puzzle = *context.puzzle;
+	int nMoves = puzzle.moves.size();
+	if (context.control->cancelled)
+		return;
+	context.nodes++;
+	if (context.nodes % BUDGET_CHECK_NODES == 0)
+		checkBudget(*context.control, BUDGET_CHECK_NODES);
+
+	// first halves that end here and add up to the right depth
+	std::map<std::vector<long long>, std::vector<int> >::iterator found = index.find(mitmKey(state, puzzle, rules));
+	if (found != index.end()) {
+		for (unsigned int n = 0; n < found->second.size(); n++) {
+			int node = found->second[n];
+			if (nodes[node].cost != depth - cost)
+				continue;
+			// the whole sequence has to be one the tree search would try
+			int moveState = nodes[node].moveState;
+			for (int j = suffix.size() - 1; j >= 0 && moveState >= 0; j--)
+				moveState = puzzle.automaton[moveState * nMoves + suffix[j]];
+			if (moveState < 0)
+				continue;
+			std::vector<int> solution;
+			for (int p = node; nodes[p].parent != -1; p = nodes[p].parent)
+				solution.push_back(nodes[p].move);
+			std::reverse(solution.begin(), solution.end());
+			for (int j = suffix.size() - 1; j >= 0; j--)
+				solution.push_back(suffix[j]);
+			solutions.push_back(solution);
+		}
+	}
+
+	unsigned char* new_state = state + puzzle.stateSize;
+	for (int i = 0; i < nMoves; i++) {
+		int newCost = cost + puzzle.moves[i].cost[context.metric];
+		if (newCost > depth - half)
+			continue;
+		// skip pairs of moves the tree search never does one after the other
+		int after = puzzle.automaton[i];
+		if (after < 0 || (!suffix.empty() && puzzle.automaton[after * nMoves + suffix.back()] < 0))
+			continue;
+		applyMove(state, new_state, inverses[i], puzzle);
+		suffix.push_back(i);
+		mitmBackward(new_state, context, depth, half, newCost, suffix, inverses, nodes, index, rules, solutions);
+		suffix.pop_back();
+	}
+}
+
+#endif
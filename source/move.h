@@ -50,6 +50,35 @@ static void applyMove(Position& state, Position& new_state, Position& move, Piec
 	}
 }
 
+// applyMove for compiled states: one pass over the flat state
+static void applyMove(const unsigned char* state, unsigned char* new_state, const compiledmove& move, const CompiledPuzzle& puzzle){
+	const unsigned short* source = &move.source[0];
+	const unsigned char* twist = &move.twist[0];
+	const unsigned char* modulus = &puzzle.modulus[0];
+	int size = puzzle.stateSize;
+	for (int i = 0; i < size; i++) {
+		unsigned char value = state[source[i]] + twist[i];
+		new_state[i] = (value >= modulus[i]) ? value - modulus[i] : value;
+	}
+}
+
+// Update the inverse of a position for a move: the inverse of the move is done
+// before it, which renames the pieces (see compileInverses). Only the given sets
+// are updated.
+static void applyInverseMove(const unsigned char* inverse, unsigned char* new_inverse, const compiledmove& move, const CompiledPuzzle& puzzle, const std::vector<int>& sets){
+	for (unsigned int k = 0; k < sets.size(); k++) {
+		const compiledset& set = puzzle.sets[sets[k]];
+		const unsigned char* label = &move.inverseLabel[set.poffset];
+		const unsigned char* twist = &move.inverseTwist[set.poffset];
+		for (int i = 0; i < set.size; i++) {
+			int piece = inverse[set.poffset + i] - 1;
+			unsigned char value = inverse[set.ooffset + i] + twist[piece];
+			new_inverse[set.poffset + i] = label[piece];
+			new_inverse[set.ooffset + i] = (value >= set.omod) ? value - set.omod : value;
+		}
+	}
+}
+
 static std::vector<int> applySubmoveO(std::vector<int> orientation, int change_o[], int change_p[], unsigned int size, int omod){
 	if (size != orientation.size()){
 		std::cerr << "Vectors not matching in size in call to applySubmoveO(...)\n";
@@ -117,17 +146,17 @@ static Position mergeMoves(Position move1, Position move2, PieceTypes& datasets)
 }
 
 // print the details of a position
-static void printPosition(Position p) {
+static void printPosition(Position p, std::ostream& out = std::cout) {
 	Position::iterator iter;
 	int i;
 	for (iter = p.begin(); iter != p.end(); iter++) {
-		std::cout << iter->first << "\n";
+		out << iter->first << "\n";
 		for (i=0; i<iter->second.size; i++)
-			std::cout << iter->second.permutation[i] << " ";
-		std::cout << "\n";
+			out << iter->second.permutation[i] << " ";
+		out << "\n";
 		for (i=0; i<iter->second.size; i++)
-			std::cout << iter->second.orientation[i] << " ";
-		std::cout << "\n";
+			out << iter->second.orientation[i] << " ";
+		out << "\n";
 	}
 }
 
@@ -145,6 +174,10 @@ static bool limitMatches(MoveLimit& limit, fullmove& move) {
 	return limit.move == (limit.moveGroup ? move.parentID : move.id);
 }
 
+static bool limitMatches(MoveLimit& limit, compiledmove& move) {
+	return limit.move == (limit.moveGroup ? move.parentID : move.id);
+}
+
 static int getMoveID(string name, MoveList& moves) {
 	MoveList::iterator iter;
 	for (iter = moves.begin(); iter != moves.end(); iter++) {
@@ -0,0 +1,353 @@
+/*
+ KSolve+ - Puzzle solving program.
+ Copyright (C) 2007-2013 Kre Krig and Michael Gottlieb
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Functions for the phased search, which solves a scramble in several steps
+// for a short (but not always optimal) solution
+
+#ifndef PHASES_H
+#define PHASES_H
+
+// Compile a phase: the puzzle with only the phase's moves, and pruning tables
+// for reaching what the phase solves with those moves. tables are the puzzle's
+// own tables, whose move tables are reused, and defIgnore is what the def file
+// lets scrambles ignore. The tables are not saved to a file.
+static void compilePhase(PhaseDef& def, CompiledPhase& phase, CompiledPuzzle& puzzle, Position& solved, MoveList& moves, PieceTypes datasets, Position& defIgnore, PruneTable& tables){
+	std::cout << "Computing pruning tables for phase " << def.name << ".\n";
+	phase.name = def.name;
+	phase.ignore = compileIgnore(def.ignore, puzzle);
+
+	// the phase's moves, in the order of the puzzle's moves
+	MoveList phaseMoves;
+	std::vector<int> kept; // index of each one in puzzle.moves
+	for (unsigned int m = 0; m < puzzle.moves.size(); m++){
+		int id = puzzle.moves[m].id;
+		if (def.moves.empty() || std::find(def.moves.begin(), def.moves.end(), id) != def.moves.end()){
+			kept.push_back(m);
+			phaseMoves[id] = moves[id];
+		}
+	}
+
+	// the puzzle with only those moves. The phase may not have the puzzle's
+	// symmetries, so it keeps only the identity.
+	phase.puzzle = puzzle;
+	CompiledPuzzle& phasePuzzle = phase.puzzle;
+	phasePuzzle.moves.clear();
+	phasePuzzle.moveIndex.clear();
+	for (unsigned int k = 0; k < kept.size(); k++){
+		phasePuzzle.moveIndex[puzzle.moves[kept[k]].id] = phasePuzzle.moves.size();
+		phasePuzzle.moves.push_back(puzzle.moves[kept[k]]);
+	}
+	// the puzzle's automaton, with only the phase's moves. Its states are the
+	// puzzle's, so a phase can carry on from where the moves of the earlier
+	// phases leave the automaton (see phaseStartState).
+	int nMoves = puzzle.moves.size();
+	phasePuzzle.automaton.clear();
+	for (int st = 0; st < puzzle.automatonStates; st++)
+		for (unsigned int k = 0; k < kept.size(); k++)
+			phasePuzzle.automaton.push_back(puzzle.automaton[st * nMoves + kept[k]]);
+	phasePuzzle.symmetries.resize(1);
+	for (unsigned int s = 0; s < phasePuzzle.sets.size(); s++)
+		phasePuzzle.sets[s].symmetries.resize(1);
+
+	// the puzzle's move tables, cut down to the phase's moves
+	PruneTable::iterator iter;
+	for (iter = tables.begin(); iter != tables.end(); iter++){
+		std::vector<int>* parts[2] = {&iter->second.permutationmoves, &iter->second.orientationmoves};
+		std::vector<int>* phaseParts[2] = {&phase.tables[iter->first].permutationmoves, &phase.tables[iter->first].orientationmoves};
+		for (int k = 0; k < 2; k++){
+			int entries = parts[k]->size() / nMoves;
+			for (int p = 0; p < entries; p++)
+				for (unsigned int m = 0; m < kept.size(); m++)
+					phaseParts[k]->push_back((*parts[k])[p * nMoves + kept[m]]);
+		}
+	}
+
+	// the tables leave out what the phase ignores, and what the def file lets
+	// scrambles ignore
+	Position ignore;
+	PieceTypes::iterator setIter;
+	for (setIter = datasets.begin(); setIter != datasets.end(); setIter++){
+		int size = setIter->second.size;
+		substate merged = newSubstate(size);
+		bool ignoring = false;
+		for (int i = 0; i < size; i++){
+			merged.permutation[i] = 0;
+			merged.orientation[i] = 0;
+			Position* sources[2] = {&def.ignore, &defIgnore};
+			for (int k = 0; k < 2; k++){
+				Position::iterator found = sources[k]->find(setIter->first);
+				if (found == sources[k]->end())
+					continue;
+				if (found->second.permutation[i] != 0)
+					merged.permutation[i] = 1;
+				if (found->second.orientation[i] != 0)
+					merged.orientation[i] = 1;
+			}
+			if (merged.permutation[i] || merged.orientation[i])
+				ignoring = true;
+		}
+		if (ignoring)
+			ignore[setIter->first] = merged;
+	}
+
+	// a permutation the phase ignores completely gets no table. It is built as
+	// if all the pieces were the same, which gives a table of one entry.
+	Position phaseSolved = solved;
+	std::vector<string> noPermutation;
+	Position::iterator ignoreIter;
+	for (ignoreIter = ignore.begin(); ignoreIter != ignore.end(); ignoreIter++){
+		substate& merged = ignoreIter->second;
+		if (std::count(merged.permutation, merged.permutation + merged.size, 0) != 0)
+			continue;
+		noPermutation.push_back(ignoreIter->first);
+		substate same = newSubstate(merged.size);
+		for (int i = 0; i < merged.size; i++){
+			same.permutation[i] = 1;
+			same.orientation[i] = solved[ignoreIter->first].orientation[i];
+			merged.permutation[i] = 0;
+		}
+		phaseSolved[ignoreIter->first] = same;
+		phase.tables[ignoreIter->first].permutationmoves.clear();
+	}
+	std::vector<int> htmCosts;
+	buildCompletePruneTables(phase.tables, phaseSolved, phaseMoves, datasets, ignore, phasePuzzle, htmCosts);
+
+	// with only some of the moves, many positions can't reach the target at
+	// all; the tables have -1 for them, which would cut nothing off
+	for (iter = phase.tables.begin(); iter != phase.tables.end(); iter++){
+		std::vector<char>* values[2] = {&iter->second.permutation, &iter->second.orientation};
+		for (int k = 0; k < 2; k++)
+			for (unsigned int i = 0; i < values[k]->size(); i++)
+				if ((*values[k])[i] < 0)
+					(*values[k])[i] = PHASE_UNREACHABLE;
+	}
+
+	updateDatasets(datasets, phase.tables);
+	for (unsigned int n = 0; n < noPermutation.size(); n++)
+		datasets[noPermutation[n]].ptabletype = TABLE_TYPE_NONE;
+	JointTables noJoints; // phases only get the tables of single sets
+	attachTables(phasePuzzle, datasets, phase.tables, noJoints);
+	estimatePruneRates(phasePuzzle);
+	std::vector<unsigned char> ignoreMask = compileIgnore(ignore, phasePuzzle);
+	compileInverses(phasePuzzle, ignoreMask);
+}
+
+// Solve a scramble in phases. Every way to do the first phase in the fewest
+// moves is tried, then in one more move and so on, each followed by the
+// shortest way to do the later phases from where it ends. Each solution that is
+// shorter than the ones before is printed, until the first phase alone would
+// take as long as the best solution, or the node or time limit is reached.
+static void solvePhases(ScrambleDef& scramble, std::vector<CompiledPhase>& phases, CompiledPuzzle& puzzle, Options& options, SolutionSink* sink, std::ostream& out){
+	out << "Solving in " << phases.size() << " phases\n";
+	if (scramble.moveLimits.size() != 0)
+		out << "MoveLimits are not used in a phased search.\n";
+
+	std::vector<unsigned char> state(puzzle.stateSize);
+	compilePosition(scramble.state, puzzle, &state[0]);
+	std::vector<unsigned char> scrambleIgnore = compileIgnore(scramble.ignore, puzzle);
+
+	PhaseRun run;
+	run.phases = &phases;
+	run.puzzle = &puzzle;
+	run.options = &options;
+	run.sink = sink;
+	run.out = &out;
+	run.metric = scramble.metric;
+	run.ignore.resize(phases.size());
+	run.masks.resize(phases.size());
+	run.pruneOrder.resize(phases.size());
+	for (unsigned int k = 0; k < phases.size(); k++){
+		// the target of each phase: solved, apart from what the phase or the scramble ignores
+		std::vector<unsigned char>& ignore = run.ignore[k];
+		ignore.assign(puzzle.stateSize, 0);
+		for (int i = 0; i < puzzle.stateSize; i++)
+			ignore[i] = (!phases[k].ignore.empty() && phases[k].ignore[i]) || (!scrambleIgnore.empty() && scrambleIgnore[i]);
+		if (std::find(ignore.begin(), ignore.end(), 1) == ignore.end())
+			ignore.clear();
+		compileIgnoreMasks(ignore, phases[k].puzzle, run.masks[k]);
+		orderPruningTables(phases[k].puzzle, options.pruneOrder, run.masks[k].skip, run.pruneOrder[k]);
+	}
+	run.parts.resize(phases.size());
+	run.costs.assign(phases.size(), 0);
+	run.best = scramble.max_depth + 1;
+	run.solutionFound = false;
+	run.nodes = 0;
+	run.nodeLimit = scramble.nodeLimit;
+	run.startTime = wallTime();
+	run.timeLimit = scramble.timeLimit;
+	run.outOfNodes = false;
+	run.outOfTime = false;
+
+	searchPhase(run, 0, &state[0], 0);
+
+	if (run.outOfNodes || run.outOfTime)
+		out << "\n" << (run.outOfNodes ? "Node" : "Time") << " limit reached, stopping.\n";
+	if (!run.solutionFound)
+		out << "No solution found.\n";
+	out << "Nodes: " << run.nodes << "\n";
+}
+
+// Search phase k from state, which is used moves (or quarter turns) from the
+// scramble, for ways to finish that are shorter than the best solution so far.
+// The solutions of the phase go on to the next phase through a PhaseSink.
+static void searchPhase(PhaseRun& run, int k, unsigned char* state, int used){
+	CompiledPuzzle& puzzle = (*run.phases)[k].puzzle;
+	bool last = (k + 1 == (int)run.phases->size());
+
+	SearchContext context;
+	context.puzzle = &puzzle;
+	context.ignore = &run.ignore[k];
+	context.masks = &run.masks[k];
+	context.pruneOrder = &run.pruneOrder[k];
+	context.metric = run.metric;
+	context.startState = phaseStartState(run, k);
+	context.minCost = minMoveCost(puzzle, run.metric);
+	context.images = NULL;
+	context.alternatives = NULL;
+	context.prefixLength = 0;
+	context.table = NULL;
+	context.sequence = NULL;
+	context.thread = 0;
+	context.tableHits = 0;
+	context.tableMisses = 0;
+	context.stats = NULL;
+	PhaseSink sink(run, k, state, used);
+	context.sink = &sink;
+	CompiledLimits limits;
+	LimitCounts limitCounts;
+	std::vector<MoveLimit> noLimits;
+	compileLimits(noLimits, puzzle, run.ignore[k], limits, limitCounts);
+	context.limits = &limits;
+	std::vector<int> coords(puzzle.coords.size() + 1);
+	computeCoords(state, puzzle, &coords[0]);
+	std::vector<int> invertible;
+	std::vector<unsigned char> inverse(puzzle.stateSize);
+	if (run.options->inversePruning){
+		invertible = inverseSets(state, run.ignore[k], puzzle);
+		if (!invertible.empty())
+			invertPosition(state, &inverse[0], puzzle, invertible);
+	}
+	context.inverseSets = invertible.empty() ? NULL : &invertible;
+
+	// one thread, since the next phases are searched from inside this search
+	Options options = *run.options;
+	options.splitDepth = -1;
+	for (int depth = 0; used + depth < run.best && !run.outOfNodes && !run.outOfTime; depth += context.excess){
+		SearchControl control;
+		control.solutions = 0;
+		control.maxSolutions = last ? 1 : 0; // the first is the shortest
+		control.nodes = 0;
+		control.nodeLimit = (run.nodeLimit > 0) ? std::max(1LL, run.nodeLimit - run.nodes) : 0;
+		control.startTime = run.startTime;
+		control.timeLimit = run.timeLimit;
+		control.outOfNodes = false;
+		control.outOfTime = false;
+		control.cancelled = false;
+		context.control = &control;
+		sink.control = &control;
+		context.nodes = 0;
+		std::vector<long long> threadNodes(1, 0);
+		bool found = parallelSolve(state, invertible.empty() ? NULL : &inverse[0], &coords[0], context, depth, limitCounts, options, threadNodes, NULL);
+		run.nodes += totalNodes(context, threadNodes);
+		run.outOfNodes = run.outOfNodes || control.outOfNodes || (run.nodeLimit > 0 && run.nodes >= run.nodeLimit);
+		run.outOfTime = run.outOfTime || control.outOfTime;
+		if ((found && last) || context.excess == NO_EXCESS)
+			break;
+	}
+}
+
+// The state of the move automaton after the moves of the phases before phase k,
+// so that the phase doesn't start with a move that is redundant after them
+// (like R2 after R). The phases share the puzzle's automaton states.
+static int phaseStartState(PhaseRun& run, int k){
+	CompiledPuzzle& puzzle = *run.puzzle;
+	int nMoves = puzzle.moves.size();
+	int state = 0;
+	for (int j = 0; j < k; j++)
+		for (unsigned int m = 0; m < run.parts[j].size(); m++)
+			state = puzzle.automaton[state * nMoves + run.parts[j][m]];
+	return state;
+}
+
+// A way to do phase k that was found from start, which was used moves from the
+// scramble: if it can still lead to a shorter solution, search the next phase
+// from where it ends, or if it was the last phase, print the solution
+static void phaseFound(PhaseRun& run, int k, unsigned char* start, int used, const int* moves, int length, SearchControl& control){
+	CompiledPuzzle& puzzle = (*run.phases)[k].puzzle;
+	if (run.outOfNodes || run.outOfTime){
+		control.cancelled = true;
+		return;
+	}
+	int cost = 0;
+	for (int m = 0; m < length; m++)
+		cost += puzzle.moves[moves[m]].cost[run.metric];
+	if (used + cost >= run.best)
+		return;
+	run.costs[k] = cost;
+	run.parts[k].clear();
+	for (int m = 0; m < length; m++)
+		run.parts[k].push_back(run.puzzle->moveIndex[puzzle.moves[moves[m]].id]);
+
+	if (k + 1 == (int)run.phases->size()){
+		run.best = used + cost;
+		run.solutionFound = true;
+		std::vector<int> solution;
+		*run.out << "Phases:";
+		for (int j = 0; j <= k; j++){
+			*run.out << (j > 0 ? " +" : "") << " " << run.costs[j];
+			solution.insert(solution.end(), run.parts[j].begin(), run.parts[j].end());
+		}
+		*run.out << " = " << run.best << "\n";
+		run.out->flush();
+		run.sink->found(0, solution.empty() ? NULL : &solution[0], solution.size());
+		run.sink->flush(0);
+		return;
+	}
+
+	// where this phase ends
+	std::vector<unsigned char> end(start, start + puzzle.stateSize);
+	std::vector<unsigned char> next(puzzle.stateSize);
+	for (int m = 0; m < length; m++){
+		applyMove(&end[0], &next[0], puzzle.moves[moves[m]], puzzle);
+		end.swap(next);
+	}
+	searchPhase(run, k + 1, &end[0], used + cost);
+	if (run.outOfNodes || run.outOfTime)
+		control.cancelled = true;
+}
+
+// Takes the solutions of one phase of a phased search, see phaseFound
+class PhaseSink : public SolutionSink {
+public:
+	PhaseSink(PhaseRun& run, int phase, unsigned char* start, int used) : control(NULL), run(run), phase(phase), start(start), used(used) {}
+
+	virtual void found(int thread, const int* moves, int length) {
+		phaseFound(run, phase, start, used, moves, length, *control);
+	}
+
+	SearchControl* control; // of the search that finds the solutions
+
+private:
+	PhaseRun& run;
+	int phase;
+	unsigned char* start;
+	int used;
+};
+
+#endif
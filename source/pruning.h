@@ -22,60 +22,41 @@
 #ifndef PRUNING_H
 #define PRUNING_H
 
-static PruneTable getCompletePruneTables(Position solved, MoveList moves, PieceTypes datasets, Position ignore, string filename, bool usePruneTable)
+// Load the pruning tables from file, or build them (and save them). costs are
+// what each move costs (in the order of moves), or empty for HTM, and the
+// tables for them are kept in a file of their own, named with metricKey. The
+// tables of the PruneTable commands go in joints, after the ones of the sets.
+static PruneTable getCompletePruneTables(Position solved, MoveList moves, PieceTypes datasets, Position ignore, string filename, bool usePruneTable, CompiledPuzzle& puzzle, std::vector<int>& costs, string metricKey, JointTables& joints)
 {
 	PruneTable table;
-	string filename2 = filename + ".tables";
+	string filename2 = filename + metricKey + ".tables";
 	std::ifstream fin;
 	fin.open(filename2.c_str(), std::ios::in | std::ios::binary);
 	
 	bool tablesExist = usePruneTable && fin.is_open(); // do tables exist?
 	bool oldTables = false; // are the tables older than the def file?
+	bool otherSymmetries = false; // were the partial tables reduced by other symmetries?
 	
+	// the checksum is the number of symmetries the partial tables were reduced by
+	int checksum = puzzle.symmetries.size();
 	if (tablesExist) {
 		fin.close(); // close ifstream so we can open a handle
-
-		// Changed HANDLE, FILETIME, GetFileTime, CreateFile, and CompareFileTime to Linux/C++ Equivalent -Matt S.
-		struct stat defWrite, tableWrite;
-		std::ofstream defHandle, tableHandle;
-		
-		defHandle.open(filename.c_str(), std::ios::in | std::ios::binary);
-		if (!defHandle.is_open()) {
-			std::cerr << "defHandle fail\n";
-			exit(-1);
-		}
-		if (stat(filename.c_str(), &defWrite) == -1) {
-			std::cerr << "stat of def fail\n";
-			exit(-1);
-		}
-		defHandle.close();
-		
-		tableHandle.open(filename2.c_str(), std::ios::in | std::ios::binary);
-		if (!tableHandle.is_open()) {
-			std::cerr << "tableHandle fail\n";
-			exit(-1);
-		}
-		if (stat(filename2.c_str(), &tableWrite) == -1) {
-			std::cerr << "stat of table fail\n";
-			exit(-1);
-		}
-		tableHandle.close();
-
-		if (difftime(defWrite.st_mtime, tableWrite.st_mtime) > 0) { // yes, def file is newer!
-			oldTables = true;
-		}
+		oldTables = tablesOlderThanDef(filename, filename2);
 		
 		// reopen ifstream
 		fin.open(filename2.c_str(), std::ios::in | std::ios::binary);
+		int fileChecksum;
+		fin.read((char*) (&fileChecksum), sizeof(fileChecksum));
+		otherSymmetries = (fileChecksum != checksum);
 	}
+
+	// the move tables are needed both to build the pruning tables and to search
+	getMoveTables(table, joints, solved, moves, datasets, filename, usePruneTable);
 	
-	if (tablesExist && !oldTables){
+	if (tablesExist && !oldTables && !otherSymmetries){
 		std::cout << "Pruning tables found on file.\n";
 		
 		// Tables exist
-		int checksum;
-		fin.read((char*) (&checksum), sizeof(checksum)); // Not used yet
-
 		Position::iterator iter;
 		for (iter = solved.begin(); iter != solved.end(); iter++){
 			int size = solved[iter->first].size;
@@ -162,19 +143,40 @@ static PruneTable getCompletePruneTables(Position solved, MoveList moves, PieceT
 				table[iter->first].partialorientation_depth = maxDepth(table[iter->first].partialorientation);
 			}
 		}
+
+		// Joint tables
+		for (unsigned int j = 0; j < joints.size(); j++){
+			std::vector<std::vector<int>*> moveTables;
+			std::vector<long long> size;
+			long long entries = jointLayout(joints[j], table, moves.size(), moveTables, size);
+			long long fileEntries = 0;
+			fin.read((char*) (&fileEntries), sizeof(fileEntries));
+			if (fin.fail() || fileEntries != entries){
+				std::cout << "Pruning table for " << joints[j].name << " not found on file, computing.\n";
+				buildJointTable(joints[j], table, solved, ignore, datasets, moves.size(), costs, std::cout);
+				continue;
+			}
+			joints[j].table.resize(entries);
+			fin.read(&joints[j].table[0], entries);
+		}
 		fin.close();
 		
 	}    
 	else{
-		if (tablesExist) { // tables exist, but they're old
+		if (tablesExist && oldTables) { // tables exist, but they're old
 			std::cout << "Pruning tables older than def file, recomputing.\n";
+		} else if (tablesExist) { // tables exist, but don't fit the symmetries
+			std::cout << "Pruning tables use other symmetries, recomputing.\n";
 		} else { // no tables on file
 			std::cout << "Pruning tables not found on file, computing.\n";
 		}
-		table = buildCompletePruneTables(solved, moves, datasets, ignore);
+		if (tablesExist)
+			fin.close();
+		buildCompletePruneTables(table, solved, moves, datasets, ignore, puzzle, costs);
+		for (unsigned int j = 0; j < joints.size(); j++)
+			buildJointTable(joints[j], table, solved, ignore, datasets, moves.size(), costs, std::cout);
 		std::ofstream fout;
 		fout.open(filename2.c_str(), std::ios::out | std::ios::binary);
-		int checksum = 1; // Not used yet
 		fout.write((char*) (&checksum), sizeof(checksum));
 		Position::iterator iter;
 		for (iter = solved.begin(); iter != solved.end(); iter++){
@@ -242,17 +244,364 @@ static PruneTable getCompletePruneTables(Position solved, MoveList moves, PieceT
 				}
 			}
 		}
+		for (unsigned int j = 0; j < joints.size(); j++){
+			long long entries = joints[j].table.size();
+			fout.write((char*) (&entries), sizeof(entries));
+			fout.write(&joints[j].table[0], entries);
+		}
 		fout.close();
 
 	}
 	return table;
 }
-				
-static PruneTable buildCompletePruneTables(Position solved, MoveList moves, PieceTypes datasets, Position ignore)
+
+// Compile the puzzle for metric k (see compileMetrics), with pruning tables
+// that count each move at its cost in it. Only the symmetries that keep the
+// costs are kept, and the search uses the move tables of puzzle, which has the
+// same coordinates.
+static void compileMetric(CompiledMetric& metric, int k, CompiledPuzzle& puzzle, Position& solved, MoveList& moves, PieceTypes datasets, Position& ignore, std::vector<unsigned char>& defIgnore, string filename, bool usePruneTable, JointTables& joints)
+{
+	metric.puzzle = puzzle;
+	CompiledPuzzle& metricPuzzle = metric.puzzle;
+	int nMoves = puzzle.moves.size();
+	std::vector<compiledsymmetry> kept;
+	for (unsigned int g = 0; g < puzzle.symmetries.size(); g++){
+		bool keepsCosts = true;
+		for (int m = 0; m < nMoves; m++)
+			if (puzzle.moves[m].cost[k] != puzzle.moves[puzzle.symmetries[g].move[m]].cost[k])
+				keepsCosts = false;
+		if (keepsCosts)
+			kept.push_back(puzzle.symmetries[g]);
+	}
+	metricPuzzle.symmetries = kept;
+	findSetSymmetries(metricPuzzle);
+
+	// the tables of QTM get a name of their own, others a hash of the costs
+	std::vector<int> costs;
+	bool qtm = true;
+	unsigned int hash = 2166136261u;
+	for (int m = 0; m < nMoves; m++){
+		costs.push_back(puzzle.moves[m].cost[k]);
+		if (costs[m] != puzzle.moves[m].qtm)
+			qtm = false;
+		hash = (hash ^ costs[m]) * 16777619u;
+	}
+	std::ostringstream metricKey;
+	if (qtm)
+		metricKey << ".qtm";
+	else
+		metricKey << ".cost" << std::hex << hash;
+	std::cout << "Pruning tables for " << (qtm ? "QTM" : "the move costs") << ":\n";
+
+	metric.joints = joints;
+	for (unsigned int j = 0; j < metric.joints.size(); j++){
+		std::vector<char>().swap(metric.joints[j].table);
+		metric.joints[j].subsetMoves.clear();
+	}
+	metric.tables = getCompletePruneTables(solved, moves, datasets, ignore, filename, usePruneTable, metricPuzzle, costs, metricKey.str(), metric.joints);
+	updateDatasets(datasets, metric.tables);
+	attachTables(metricPuzzle, datasets, metric.tables, metric.joints);
+	for (unsigned int c = 0; c < metricPuzzle.coords.size(); c++)
+		metricPuzzle.coords[c].moves = puzzle.coords[c].moves;
+	PruneTable::iterator iter;
+	for (iter = metric.tables.begin(); iter != metric.tables.end(); iter++){
+		std::vector<int>().swap(iter->second.permutationmoves);
+		std::vector<int>().swap(iter->second.orientationmoves);
+	}
+	for (unsigned int j = 0; j < metric.joints.size(); j++)
+		std::vector<std::vector<int> >().swap(metric.joints[j].subsetMoves);
+	estimatePruneRates(metricPuzzle);
+	compileInverses(metricPuzzle, defIgnore);
+}
+
+// Is the table file older than the def file it was computed from?
+static bool tablesOlderThanDef(string filename, string filename2)
+{
+	// Changed HANDLE, FILETIME, GetFileTime, CreateFile, and CompareFileTime to Linux/C++ Equivalent -Matt S.
+	struct stat defWrite, tableWrite;
+	std::ofstream defHandle, tableHandle;
+	
+	defHandle.open(filename.c_str(), std::ios::in | std::ios::binary);
+	if (!defHandle.is_open()) {
+		std::cerr << "defHandle fail\n";
+		exit(-1);
+	}
+	if (stat(filename.c_str(), &defWrite) == -1) {
+		std::cerr << "stat of def fail\n";
+		exit(-1);
+	}
+	defHandle.close();
+	
+	tableHandle.open(filename2.c_str(), std::ios::in | std::ios::binary);
+	if (!tableHandle.is_open()) {
+		std::cerr << "tableHandle fail\n";
+		exit(-1);
+	}
+	if (stat(filename2.c_str(), &tableWrite) == -1) {
+		std::cerr << "stat of table fail\n";
+		exit(-1);
+	}
+	tableHandle.close();
+
+	return difftime(defWrite.st_mtime, tableWrite.st_mtime) > 0; // yes, def file is newer!
+}
+
+// Number of entries in the complete permutation table of a set, or -1 if it only gets a partial table
+static long long completePermutationSize(Position& solved, string setname)
+{
+	int size = solved[setname].size;
+	if (factorial(size) <= MAX_COMPLETE_PERMUTATION_TABLE_SIZE && factorial(size) != -1 && uniquePermutation(solved[setname].permutation, size))
+		return factorial(size);
+	long long comb = combinations(solved[setname].permutation, size);
+	if (comb <= MAX_COMPLETE_PERMUTATION_TABLE_SIZE && comb != -1)
+		return comb;
+	return -1;
+}
+
+// Number of entries in the complete orientation table of a set, or -1 if it only gets a partial table
+static long long completeOrientationSize(PieceTypes& datasets, string setname)
+{
+	double osize = log(datasets[setname].omod) * datasets[setname].size;
+	if (osize >= log(MAX_COMPLETE_ORIENTATION_TABLE_SIZE))
+		return -1;
+	long long num = 1;
+	for (int t = 0; t < datasets[setname].size; t++)
+		num *= datasets[setname].omod;
+	return num;
+}
+
+// Load the coordinate move tables from file, or build them (and save them) if
+// they are missing or older than the def file. The parts of the joint tables
+// that track some pieces get theirs after the ones of the sets.
+static void getMoveTables(PruneTable& table, JointTables& joints, Position& solved, MoveList& moves, PieceTypes& datasets, string filename, bool usePruneTable)
+{
+	string filename2 = filename + ".movetables";
+	int nMoves = moves.size();
+	bool loaded = false;
+	Position::iterator iter;
+
+	std::ifstream fin;
+	if (usePruneTable)
+		fin.open(filename2.c_str(), std::ios::in | std::ios::binary);
+	if (fin.is_open()) {
+		fin.close();
+		if (!tablesOlderThanDef(filename, filename2)) {
+			fin.open(filename2.c_str(), std::ios::in | std::ios::binary);
+			int checksum, fileMoves;
+			fin.read((char*) (&checksum), sizeof(checksum)); // Not used yet
+			fin.read((char*) (&fileMoves), sizeof(fileMoves));
+			loaded = !fin.fail() && fileMoves == nMoves;
+			for (iter = solved.begin(); iter != solved.end() && loaded; iter++){
+				std::vector<int>* parts[2] = {&table[iter->first].permutationmoves, &table[iter->first].orientationmoves};
+				for (int k = 0; k < 2 && loaded; k++){
+					int entries;
+					fin.read((char*) (&entries), sizeof(entries));
+					parts[k]->resize(entries);
+					if (entries > 0)
+						fin.read((char*) (&(*parts[k])[0]), entries * sizeof(int));
+					loaded = !fin.fail();
+				}
+			}
+			for (unsigned int j = 0; j < joints.size() && loaded; j++){
+				joints[j].subsetMoves.assign(joints[j].parts.size(), std::vector<int>());
+				for (unsigned int k = 0; k < joints[j].parts.size() && loaded; k++){
+					int entries;
+					fin.read((char*) (&entries), sizeof(entries));
+					loaded = !fin.fail() && (entries > 0) == !joints[j].parts[k].pieces.empty();
+					if (!loaded)
+						break;
+					joints[j].subsetMoves[k].resize(entries);
+					if (entries > 0)
+						fin.read((char*) (&joints[j].subsetMoves[k][0]), entries * sizeof(int));
+					loaded = !fin.fail();
+				}
+			}
+			fin.close();
+			if (loaded)
+				std::cout << "Move tables found on file.\n";
+		}
+	}
+	if (loaded)
+		return;
+
+	for (iter = solved.begin(); iter != solved.end(); iter++){
+		int size = iter->second.size;
+		long long psize = completePermutationSize(solved, iter->first);
+		if (psize != -1 && psize * nMoves <= MAX_MOVE_TABLE_SIZE) {
+			std::vector<int> temp_perm (iter->second.permutation, iter->second.permutation + size);
+			table[iter->first].permutationmoves = buildPermutationMoveTable(temp_perm, moves, iter->first, uniquePermutation(temp_perm));
+		}
+		long long osize = completeOrientationSize(datasets, iter->first);
+		if (osize > 1 && osize * nMoves <= MAX_MOVE_TABLE_SIZE)
+			table[iter->first].orientationmoves = buildOrientationMoveTable(osize, size, moves, iter->first, datasets[iter->first].omod);
+	}
+	for (unsigned int j = 0; j < joints.size(); j++){
+		joints[j].subsetMoves.assign(joints[j].parts.size(), std::vector<int>());
+		for (unsigned int k = 0; k < joints[j].parts.size(); k++){
+			JointPart& part = joints[j].parts[k];
+			if (!part.pieces.empty())
+				joints[j].subsetMoves[k] = buildSubsetMoveTable(part, solved[part.set], datasets[part.set].omod, moves);
+		}
+	}
+
+	if (usePruneTable) {
+		std::ofstream fout;
+		fout.open(filename2.c_str(), std::ios::out | std::ios::binary);
+		int checksum = 1; // Not used yet
+		fout.write((char*) (&checksum), sizeof(checksum));
+		fout.write((char*) (&nMoves), sizeof(nMoves));
+		for (iter = solved.begin(); iter != solved.end(); iter++){
+			std::vector<int>* parts[2] = {&table[iter->first].permutationmoves, &table[iter->first].orientationmoves};
+			for (int k = 0; k < 2; k++){
+				int entries = parts[k]->size();
+				fout.write((char*) (&entries), sizeof(entries));
+				if (entries > 0)
+					fout.write((char*) (&(*parts[k])[0]), entries * sizeof(int));
+			}
+		}
+		for (unsigned int j = 0; j < joints.size(); j++){
+			for (unsigned int k = 0; k < joints[j].subsetMoves.size(); k++){
+				int entries = joints[j].subsetMoves[k].size();
+				fout.write((char*) (&entries), sizeof(entries));
+				if (entries > 0)
+					fout.write((char*) (&joints[j].subsetMoves[k][0]), entries * sizeof(int));
+			}
+		}
+		fout.close();
+	}
+}
+
+// Transition table for the orientation of one set: entry [index * moves + move]
+static std::vector<int> buildOrientationMoveTable(int tablesize, int vector_size, MoveList& moves, string setname, int omod)
+{
+	std::cout << "Building move table for " << setname << " orientation.\n";
+	int nMoves = moves.size();
+	std::vector<int> table (tablesize * nMoves);
+	for (int p = 0; p < tablesize; p++){
+		std::vector<int> orientation = oIndex2Vector(p, vector_size, omod);
+		int m = 0;
+		for (MoveList::iterator iter = moves.begin(); iter != moves.end(); iter++, m++){
+			substate& move = iter->second.state[setname];
+			table[p * nMoves + m] = oVector2Index(applySubmoveO(orientation, move.orientation, move.permutation, move.size, omod), omod);
+		}
+	}
+	return table;
+}
+
+// Transition table for the permutation of one set: entry [index * moves + move]
+static std::vector<int> buildPermutationMoveTable(std::vector<int> solved, MoveList& moves, string setname, bool unique)
+{
+	std::cout << "Building move table for " << setname << " permutation.\n";
+	int nMoves = moves.size();
+	int vector_size = solved.size();
+	int tablesize = unique ? factorial(vector_size) : combinations(solved);
+	std::vector<int> table (tablesize * nMoves);
+	for (int p = 0; p < tablesize; p++){
+		int* permutation = unique ? pIndex2Array(p, vector_size) : pIndex3Array(p, solved);
+		int m = 0;
+		for (MoveList::iterator iter = moves.begin(); iter != moves.end(); iter++, m++){
+			int* moved = applySubmoveP(permutation, iter->second.state[setname].permutation, vector_size);
+			table[p * nMoves + m] = unique ? pVector2Index(moved, vector_size) : pVector3Index(moved, vector_size);
+			delete[] moved;
+		}
+		delete[] permutation;
+	}
+	return table;
+}
+
+// The pieces a part of a joint table tracks, as tracked[piece number], and the
+// number the other pieces count as: one more than any piece number of the set
+// when solved (see subsetIndex)
+static int subsetTracked(JointPart& part, int* solved, int size, std::vector<char>& tracked)
+{
+	tracked.assign(MAX_COMPILED_VALUE + 1, 0);
+	for (unsigned int i = 0; i < part.pieces.size(); i++)
+		tracked[part.pieces[i]] = 1;
+	int other = 1;
+	for (int i = 0; i < size; i++)
+		other = std::max(other, solved[i] + 1);
+	return other;
+}
+
+// The solved permutation of a part with pieces, with the pieces it doesn't
+// track numbered other
+static std::vector<int> subsetTarget(int* solved, int size, std::vector<char>& tracked, int other)
+{
+	std::vector<int> target;
+	for (int i = 0; i < size; i++)
+		target.push_back(tracked[solved[i]] ? solved[i] : other);
+	return target;
+}
+
+// Transition table for a part of a joint table that tracks some pieces: entry
+// [index * moves + move], with the index from subsetIndex
+static std::vector<int> buildSubsetMoveTable(JointPart& part, substate& solved, int omod, MoveList& moves)
+{
+	std::cout << "Building move table for " << part.name << ".\n";
+	int nMoves = moves.size();
+	int size = solved.size;
+	std::vector<char> tracked;
+	int other = subsetTracked(part, solved.permutation, size, tracked);
+	std::vector<int> target = subsetTarget(solved.permutation, size, tracked, other);
+	int partOmod = part.orientation ? omod : 1;
+	long long tablesize = subsetSize(target, other, partOmod);
+	if (tablesize == -1 || tablesize * nMoves > MAX_MOVE_TABLE_SIZE){
+		std::cerr << "The move table of " << part.name << " in PruneTable would have more than " << MAX_MOVE_TABLE_SIZE << " entries; track fewer pieces.\n";
+		exit(-1);
+	}
+
+	std::vector<int> table (tablesize * nMoves);
+	std::vector<int> permutation(size), orientation(size), moved(size), twisted(size);
+	for (long long p = 0; p < tablesize; p++){
+		subsetPosition(p, target, other, partOmod, &permutation[0], &orientation[0]);
+		int m = 0;
+		for (MoveList::iterator iter = moves.begin(); iter != moves.end(); iter++, m++){
+			substate& move = iter->second.state[part.set];
+			for (int i = 0; i < size; i++){
+				int from = move.permutation[i] - 1;
+				moved[i] = permutation[from];
+				twisted[i] = (orientation[from] + move.orientation[from]) % partOmod;
+			}
+			table[p * nMoves + m] = subsetIndex(&moved[0], &twisted[0], size, tracked, other, partOmod);
+		}
+	}
+	return table;
+}
+
+// Which entries of a part with pieces are solved: the tracked pieces are where
+// they are when solved, and not twisted, apart from what the def file ignores
+static std::vector<char> subsetSolved(JointPart& part, substate& solved, Position& ignore, int omod, long long tablesize)
+{
+	int size = solved.size;
+	std::vector<char> tracked;
+	int other = subsetTracked(part, solved.permutation, size, tracked);
+	std::vector<int> target = subsetTarget(solved.permutation, size, tracked, other);
+	int partOmod = part.orientation ? omod : 1;
+	Position::iterator ignored = ignore.find(part.set);
+	std::vector<char> solvedEntries(tablesize, 0);
+	std::vector<int> permutation(size), orientation(size);
+	for (long long p = 0; p < tablesize; p++){
+		subsetPosition(p, target, other, partOmod, &permutation[0], &orientation[0]);
+		bool isSolved = true;
+		for (int i = 0; i < size && isSolved; i++){
+			if (ignored == ignore.end() || ignored->second.permutation[i] == 0)
+				isSolved = (permutation[i] == target[i]);
+			if (isSolved && permutation[i] != other && (ignored == ignore.end() || ignored->second.orientation[i] == 0))
+				isSolved = (orientation[i] == solved.orientation[i] % partOmod);
+		}
+		solvedEntries[p] = isSolved;
+	}
+	return solvedEntries;
+}
+
+// Build the pruning tables of every set. costs are what each move costs (in the
+// order of moves), or empty if every move costs 1. The partial tables are built
+// first, then the complete ones (see buildTableJobs).
+static void buildCompletePruneTables(PruneTable& table, Position solved, MoveList moves, PieceTypes datasets, Position ignore, CompiledPuzzle& puzzle, std::vector<int>& costs)
 {
 	Position::iterator iter;
-	PruneTable table;
 	std::vector<int> tmp_ignore;
+	std::vector<TableJob> jobs;
 	for (iter = solved.begin(); iter != solved.end(); iter++){
 		int size = solved[iter->first].size;
 		tmp_ignore.clear();
@@ -262,24 +611,26 @@ static PruneTable buildCompletePruneTables(Position solved, MoveList moves, Piec
 			
 		if (factorial(size) <= MAX_COMPLETE_PERMUTATION_TABLE_SIZE && factorial(size) != -1 && uniquePermutation(solved[iter->first].permutation, size)){
 			// Complete table, unique pieces
-			std::vector<int> temp_perm;
+			TableJob job(TABLE_JOB_PERMUTATION, iter->first, tmp_ignore, table[iter->first].permutation, table[iter->first].permutationmoves);
 			for (int i = 0; i < size; i++)
-				temp_perm.push_back(solved[iter->first].permutation[i]);
-			table[iter->first].permutation = buildCompletePermutationPruningTable(temp_perm, moves, iter->first, tmp_ignore);
+				job.solved.push_back(solved[iter->first].permutation[i]);
+			job.size = factorial(size);
+			jobs.push_back(job);
 		}
 		else if (combinations(solved[iter->first].permutation, size) <= MAX_COMPLETE_PERMUTATION_TABLE_SIZE && combinations(solved[iter->first].permutation, size) != -1 && !uniquePermutation(solved[iter->first].permutation, size)){
 			// Complete table, not unique pieces
-			std::vector<int> temp_perm;
-			for (int i= 0; i < size; i++)
-				temp_perm.push_back(solved[iter->first].permutation[i]);
-			table[iter->first].permutation = buildCompletePermutationPruningTable3(temp_perm, moves, iter->first, tmp_ignore);
+			TableJob job(TABLE_JOB_PERMUTATION3, iter->first, tmp_ignore, table[iter->first].permutation, table[iter->first].permutationmoves);
+			for (int i = 0; i < size; i++)
+				job.solved.push_back(solved[iter->first].permutation[i]);
+			job.size = combinations(solved[iter->first].permutation, size);
+			jobs.push_back(job);
 		}
 		else{
 			// Partial permutation table 
 			std::vector<int> temp_perm;
 			for (int i = 0; i < size; i++)
 				temp_perm.push_back(solved[iter->first].permutation[i]);
-			table[iter->first].partialpermutation = buildPartialPermutationPruningTable(temp_perm, moves, iter->first, tmp_ignore);
+			table[iter->first].partialpermutation = buildPartialPermutationPruningTable(temp_perm, moves, iter->first, tmp_ignore, puzzle.sets[puzzle.setIndex[iter->first]].symmetries, costs);
 			table[iter->first].partialpermutation_depth = maxDepth(table[iter->first].partialpermutation);
 		}
 
@@ -289,28 +640,171 @@ static PruneTable buildCompletePruneTables(Position solved, MoveList moves, Piec
 				tmp_ignore.push_back(ignore[iter->first].orientation[i]);
 		double osize = log(datasets[iter->first].omod) * size;
 		if (osize < log(MAX_COMPLETE_ORIENTATION_TABLE_SIZE)){ // Not to big tables. Using log to avoid overflow.
-			std::vector<int> temp_orient;
+			TableJob job(TABLE_JOB_ORIENTATION, iter->first, tmp_ignore, table[iter->first].orientation, table[iter->first].orientationmoves);
 			for (int i = 0; i < size; i++)
-				temp_orient.push_back(solved[iter->first].orientation[i]);
-			table[iter->first].orientation = buildCompleteOrientationPruningTable(temp_orient , moves, iter->first, datasets[iter->first].omod, tmp_ignore);
+				job.solved.push_back(solved[iter->first].orientation[i]);
+			job.omod = datasets[iter->first].omod;
+			job.size = (long long)pow((double)job.omod, size);
+			jobs.push_back(job);
 		}
 		else{
 			std::vector<int> temp_orient;
 			for (int i = 0; i < size; i++)
 				temp_orient.push_back(solved[iter->first].orientation[i]);
-			table[iter->first].partialorientation = buildPartialOrientationPruningTable(temp_orient, moves, iter->first, datasets[iter->first].omod, tmp_ignore);
+			table[iter->first].partialorientation = buildPartialOrientationPruningTable(temp_orient, moves, iter->first, datasets[iter->first].omod, tmp_ignore, puzzle.sets[puzzle.setIndex[iter->first]].symmetries, costs);
 			table[iter->first].partialorientation_depth = maxDepth(table[iter->first].partialorientation);
 		}
 	}
-	return table;
+	buildTableJobs(jobs, moves, costs);
+}
+
+// Build the complete tables. The small ones are built at the same time, one
+// thread each, and what they print is printed after them in order; the large
+// ones are built one after another, each with every thread.
+static void buildTableJobs(std::vector<TableJob>& jobs, MoveList& moves, std::vector<int>& costs)
+{
+	std::vector<int> small;
+	for (unsigned int j = 0; j < jobs.size(); j++)
+		if (jobs[j].size < PARALLEL_TABLE_SIZE)
+			small.push_back(j);
+	int nSmall = small.size();
+	std::vector<std::string> printed(nSmall);
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int k = 0; k < nSmall; k++) {
+		std::ostringstream out;
+		buildTableJob(jobs[small[k]], moves, costs, out);
+		printed[k] = out.str();
+	}
+	for (int k = 0; k < nSmall; k++)
+		std::cout << printed[k];
+	for (unsigned int j = 0; j < jobs.size(); j++)
+		if (jobs[j].size >= PARALLEL_TABLE_SIZE)
+			buildTableJob(jobs[j], moves, costs, std::cout);
+}
+
+static void buildTableJob(TableJob& job, MoveList& moves, std::vector<int>& costs, std::ostream& out)
+{
+	if (job.type == TABLE_JOB_ORIENTATION)
+		*job.table = buildCompleteOrientationPruningTable(job.solved, moves, job.setname, job.omod, job.ignore, *job.moveTable, costs, out);
+	else if (job.type == TABLE_JOB_PERMUTATION)
+		*job.table = buildCompletePermutationPruningTable(job.solved, moves, job.setname, job.ignore, *job.moveTable, costs, out);
+	else
+		*job.table = buildCompletePermutationPruningTable3(job.solved, moves, job.setname, job.ignore, *job.moveTable, costs, out);
 }                    
 
-static std::vector<char> buildCompleteOrientationPruningTable(std::vector<int> solved, MoveList moves, string setname, int omod, std::vector<int> ignore)
+// The move tables and sizes of the parts of a joint table, and the number of
+// entries it has. Every part needs a move table, so that the search keeps its
+// coordinate up to date.
+static long long jointLayout(JointTable& joint, PruneTable& tables, int nMoves, std::vector<std::vector<int>*>& moveTables, std::vector<long long>& size)
 {
-	std::cout << "Building pruning for " << setname << " orientation.\n";
+	moveTables.clear();
+	size.clear();
+	long long total = 1;
+	for (unsigned int k = 0; k < joint.parts.size(); k++){
+		JointPart& part = joint.parts[k];
+		subprune& setTables = tables[part.set];
+		std::vector<int>* moveTable = part.orientation ? &setTables.orientationmoves : &setTables.permutationmoves;
+		if (!part.pieces.empty())
+			moveTable = &joint.subsetMoves[k];
+		if (moveTable->empty()){
+			std::cerr << "PruneTable " << joint.name << ": the " << (part.orientation ? "orientation" : "permutation") << " of " << part.set << " has no move table, as its own table is too large or has one entry. Track some of its pieces instead.\n";
+			exit(-1);
+		}
+		moveTables.push_back(moveTable);
+		size.push_back(moveTable->size() / nMoves);
+		total *= size.back();
+		if (total > MAX_JOINT_TABLE_SIZE){
+			std::cerr << "PruneTable " << joint.name << " would have more than " << MAX_JOINT_TABLE_SIZE << " entries.\n";
+			exit(-1);
+		}
+	}
+	return total;
+}
+
+// Build a joint table, layer by layer like the tables of single sets, from
+// the move tables of its parts. An entry is solved when all of its parts are,
+// which for the whole permutation or orientation of a set is when its own
+// table has a 0 for it.
+static void buildJointTable(JointTable& joint, PruneTable& tables, Position& solvedPosition, Position& ignore, PieceTypes& datasets, int nMoves, std::vector<int>& costs, std::ostream& out)
+{
+	out << "Building pruning for " << joint.name << ".\n";
+	std::vector<std::vector<int>*> moveTables;
+	std::vector<long long> size;
+	long long tablesize = jointLayout(joint, tables, nMoves, moveTables, size);
+	int nParts = size.size();
+	std::vector<long long> stride(nParts, 1);
+	for (int k = nParts - 2; k >= 0; k--)
+		stride[k] = stride[k + 1] * size[k + 1];
+	std::vector<std::vector<char> > partSolved(nParts);
+	for (int k = 0; k < nParts; k++){
+		JointPart& part = joint.parts[k];
+		if (!part.pieces.empty()){
+			partSolved[k] = subsetSolved(part, solvedPosition[part.set], ignore, datasets[part.set].omod, size[k]);
+			continue;
+		}
+		std::vector<char>& values = part.orientation ? tables[part.set].orientation : tables[part.set].permutation;
+		for (long long c = 0; c < size[k]; c++)
+			partSolved[k].push_back(values[c] == 0);
+	}
+	out << "tablesize " << tablesize << "\n";
+
+	std::vector<char>& table = joint.table;
+	table.assign(tablesize, -1);
+	std::vector<long long> count(128, 0); // entries with each value
+	for (long long p = 0; p < tablesize; p++){
+		bool solved = true;
+		for (int k = 0; k < nParts && solved; k++)
+			solved = partSolved[k][(p / stride[k]) % size[k]];
+		if (solved){
+			table[p] = 0;
+			count[0]++;
+		}
+	}
+	out << count[0] << " solved positions.\n";
+	std::vector<int> inverses = jointInverses(moveTables, nMoves);
+
+	// forwards from the entries with value len, or backwards from the ones
+	// still to be filled (see backwardLayer)
+	int len = 0;
+	int last = 0; // the largest value given out so far
+	do
+	{
+		bool backward = expandBackward(inverses, count, len, tablesize);
+		#pragma omp parallel
+		{
+			std::vector<long long> threadCount(count.size(), 0);
+			int threadLast = last;
+			std::vector<int> coord(nParts);
+			#pragma omp for schedule(dynamic, 4096)
+			for (long long p = 0; p < tablesize; p++){
+				if (backward ? (table[p] != -1 && table[p] <= len + 1) : (table[p] != len))
+					continue;
+				for (int k = 0; k < nParts; k++)
+					coord[k] = (p / stride[k]) % size[k];
+				for (int m = 0; m < nMoves; m++){
+					int n = backward ? inverses[m] : m;
+					long long q = 0;
+					for (int k = 0; k < nParts; k++)
+						q += (*moveTables[k])[coord[k] * nMoves + n] * stride[k];
+					if (!backward)
+						lowerEntry(table[q], len + moveCost(costs, m), threadCount, threadLast);
+					else if (table[q] == len)
+						lowerEntry(table[p], len + moveCost(costs, m), threadCount, threadLast);
+				}
+			}
+			mergeCounts(count, last, threadCount, threadLast);
+		}
+		len++;
+		out << count[len] << " positions at depth " << len << "\n";
+	}while(len <= last);
+}
+
+static std::vector<char> buildCompleteOrientationPruningTable(std::vector<int> solved, MoveList moves, string setname, int omod, std::vector<int> ignore, std::vector<int>& moveTable, std::vector<int>& costs, std::ostream& out)
+{
+	int nMoves = moves.size();
+	out << "Building pruning for " << setname << " orientation.\n";
 	std::vector<char> table;
 	int vector_size = solved.size();
-	MoveList::iterator iter;
 	int tablesize = 1;
 	for (unsigned int i = 0; i < solved.size(); i++)
 		tablesize *= omod;  // tablesize = omod to the power of solved.size() 
@@ -320,30 +814,46 @@ static std::vector<char> buildCompleteOrientationPruningTable(std::vector<int> s
 	for (int i = 0; i < tablesize; i++)
 		table[i] = -1;
 		
-	std::cout << "tablesize " << tablesize << "\n";
+	out << "tablesize " << tablesize << "\n";
 
 	table[oVector2Index(solved, omod)] = 0; // Put solved position in table
+	std::vector<int> inverses = moveInverses(moveTable, nMoves);
 
 	int len = 0;
 	int c;
+	int last = 0; // the largest value given out so far
+	std::vector<long long> count(128, 0); // entries with each value
 	do
 	{
-		c = 0;
-		for (int p = 0; p < tablesize; p++){
-			if (table[p] == len){
-				for (iter = moves.begin(); iter != moves.end(); iter++){
-					int q = oVector2Index(applySubmoveO(oIndex2Vector(p, vector_size, omod), iter->second.state[setname].orientation, iter->second.state[setname].permutation, iter->second.state[setname].size, omod), omod);
-					if (table[q] == -1){
-						table[q] = len + 1;
-						c++;
-					}
+		if (expandBackward(inverses, count, len, tablesize))
+			backwardLayer(table, moveTable, inverses, costs, len, count, last);
+		else {
+			#pragma omp parallel
+			{
+				std::vector<long long> threadCount(count.size(), 0);
+				int threadLast = last;
+				#pragma omp for schedule(dynamic, 4096)
+				for (int p = 0; p < tablesize; p++){
+					if (table[p] == len){
+						int m = 0;
+						for (MoveList::iterator iter = moves.begin(); iter != moves.end(); iter++, m++){
+							int q;
+							if (!moveTable.empty())
+								q = moveTable[p * nMoves + m];
+							else
+								q = oVector2Index(applySubmoveO(oIndex2Vector(p, vector_size, omod), iter->second.state[setname].orientation, iter->second.state[setname].permutation, iter->second.state[setname].size, omod), omod);
+							lowerEntry(table[q], len + moveCost(costs, m), threadCount, threadLast);
+						}
+					}      
 				}
-			}      
+				mergeCounts(count, last, threadCount, threadLast);
+			}
 		}
 		len++;
+		c = count[len];
 		if (ignore.empty()) // Dont write if first pass
-			std::cout << c << " positions at depth " << len << "\n"; 
-	}while(c > 0);
+			out << c << " positions at depth " << len << "\n"; 
+	}while(len <= last);
 	
 	if (!ignore.empty()){ // If some pieces are to be ignored, use first pass to generate all
 								// solved positions. Then generate the real table.
@@ -363,39 +873,54 @@ static std::vector<char> buildCompleteOrientationPruningTable(std::vector<int> s
 					table[i] = -1;
 			}
 		}
-		std::cout << c << " solved positions.\n";
+		out << c << " solved positions.\n";
 		
 		int len = 0;
 		int c;
+		int last = 0; // the largest value given out so far
+		std::vector<long long> count(128, 0); // entries with each value
 		do
 		{
-			c = 0;
-			for (int p = 0; p < tablesize; p++){
-				if (table[p] == len){
-					for (iter = moves.begin(); iter != moves.end(); iter++){
-						int q = oVector2Index(applySubmoveO(oIndex2Vector(p, vector_size, omod), iter->second.state[setname].orientation, iter->second.state[setname].permutation, iter->second.state[setname].size, omod), omod);
-						if (table[q] == -1){
-							table[q] = len + 1;
-							c++;
+			if (expandBackward(inverses, count, len, tablesize))
+				backwardLayer(table, moveTable, inverses, costs, len, count, last);
+			else {
+				#pragma omp parallel
+				{
+					std::vector<long long> threadCount(count.size(), 0);
+					int threadLast = last;
+					#pragma omp for schedule(dynamic, 4096)
+					for (int p = 0; p < tablesize; p++){
+						if (table[p] == len){
+							int m = 0;
+							for (MoveList::iterator iter = moves.begin(); iter != moves.end(); iter++, m++){
+								int q;
+								if (!moveTable.empty())
+									q = moveTable[p * nMoves + m];
+								else
+									q = oVector2Index(applySubmoveO(oIndex2Vector(p, vector_size, omod), iter->second.state[setname].orientation, iter->second.state[setname].permutation, iter->second.state[setname].size, omod), omod);
+								lowerEntry(table[q], len + moveCost(costs, m), threadCount, threadLast);
+							}
 						}
-					}
+					}      
+					mergeCounts(count, last, threadCount, threadLast);
 				}
-			}      
+			}
 			len++;
-			std::cout << c << " positions at depth " << len << "\n"; 
-		}while(c > 0);
+			c = count[len];
+			out << c << " positions at depth " << len << "\n"; 
+		}while(len <= last);
 	}
 	
 	return table;
 }
 
 // Complete table, unique pieces
-static std::vector<char> buildCompletePermutationPruningTable(std::vector<int> solved, MoveList moves, string setname, std::vector<int> ignore)
+static std::vector<char> buildCompletePermutationPruningTable(std::vector<int> solved, MoveList moves, string setname, std::vector<int> ignore, std::vector<int>& moveTable, std::vector<int>& costs, std::ostream& out)
 {
-	std::cout << "Building pruning for " << setname << " permutation.\n";
+	int nMoves = moves.size();
+	out << "Building pruning for " << setname << " permutation.\n";
 	std::vector<char> table;
 	int vector_size = solved.size();
-	MoveList::iterator iter;
 	int tablesize = 1;
 	tablesize = factorial(solved.size());
 	
@@ -403,32 +928,48 @@ static std::vector<char> buildCompletePermutationPruningTable(std::vector<int> s
 	for (int i = 0; i < tablesize; i++)
 		table[i] = -1;
 		
-	std::cout << "tablesize " << tablesize << "\n";
+	out << "tablesize " << tablesize << "\n";
 
 	table[pVector2Index(solved)] = 0; // Put solved position in table
+	std::vector<int> inverses = moveInverses(moveTable, nMoves);
 
 	int len = 0;
 	int c;
+	int last = 0; // the largest value given out so far
+	std::vector<long long> count(128, 0); // entries with each value
 	do
 	{
-		c = 0;
-		for (int p = 0; p < tablesize; p++){
-			if (table[p] == len){
-				for (iter = moves.begin(); iter != moves.end(); iter++){
-					int q = pVector2Index(applySubmoveP(pIndex2Array(p, vector_size), iter->second.state[setname].permutation, vector_size), vector_size);
-					if (table[q] == -1){
-						table[q] = len + 1;
-						c++;
-					}
+		if (expandBackward(inverses, count, len, tablesize))
+			backwardLayer(table, moveTable, inverses, costs, len, count, last);
+		else {
+			#pragma omp parallel
+			{
+				std::vector<long long> threadCount(count.size(), 0);
+				int threadLast = last;
+				#pragma omp for schedule(dynamic, 4096)
+				for (int p = 0; p < tablesize; p++){
+					if (table[p] == len){
+						int m = 0;
+						for (MoveList::iterator iter = moves.begin(); iter != moves.end(); iter++, m++){
+							int q;
+							if (!moveTable.empty())
+								q = moveTable[p * nMoves + m];
+							else
+								q = pVector2Index(applySubmoveP(pIndex2Array(p, vector_size), iter->second.state[setname].permutation, vector_size), vector_size);
+							lowerEntry(table[q], len + moveCost(costs, m), threadCount, threadLast);
+						}
+					}      
 				}
-			}      
+				mergeCounts(count, last, threadCount, threadLast);
+			}
 		}
 		len++;
+		c = count[len];
 		if (ignore.empty())
-			std::cout << c << " positions at depth " << len << "\n";
+			out << c << " positions at depth " << len << "\n";
 		else
-			std::cout << c << " positions in phase one, depth " << len << "\n"; 
-	}while(c > 0);
+			out << c << " positions in phase one, depth " << len << "\n"; 
+	}while(len <= last);
 
 	if (!ignore.empty()){
 		c = 0;
@@ -448,70 +989,101 @@ static std::vector<char> buildCompletePermutationPruningTable(std::vector<int> s
 				delete tmp_p;
 			}
 		}
-		std::cout << c << " solved positions.\n";
+		out << c << " solved positions.\n";
 		int len = 0;
 		int c;
+		int last = 0; // the largest value given out so far
+		std::vector<long long> count(128, 0); // entries with each value
 		do
 		{
-			c = 0;
-			for (int p = 0; p < tablesize; p++){
-				if (table[p] == len){
-					for (iter = moves.begin(); iter != moves.end(); iter++){
-						int q = pVector2Index(applySubmoveP(pIndex2Array(p, vector_size), iter->second.state[setname].permutation, vector_size), vector_size);
-						if (table[q] == -1){
-							table[q] = len + 1;
-							c++;
-						}
+			if (expandBackward(inverses, count, len, tablesize))
+				backwardLayer(table, moveTable, inverses, costs, len, count, last);
+			else {
+				#pragma omp parallel
+				{
+					std::vector<long long> threadCount(count.size(), 0);
+					int threadLast = last;
+					#pragma omp for schedule(dynamic, 4096)
+					for (int p = 0; p < tablesize; p++){
+						if (table[p] == len){
+							int m = 0;
+							for (MoveList::iterator iter = moves.begin(); iter != moves.end(); iter++, m++){
+								int q;
+								if (!moveTable.empty())
+									q = moveTable[p * nMoves + m];
+								else
+									q = pVector2Index(applySubmoveP(pIndex2Array(p, vector_size), iter->second.state[setname].permutation, vector_size), vector_size);
+								lowerEntry(table[q], len + moveCost(costs, m), threadCount, threadLast);
+							}
+						}      
 					}
-				}      
+					mergeCounts(count, last, threadCount, threadLast);
+				}
 			}
 			len++;
-			std::cout << c << " positions at depth " << len << "\n"; 
-		}while(c > 0);
+			c = count[len];
+			out << c << " positions at depth " << len << "\n"; 
+		}while(len <= last);
 	}
 
 	return table;
 }
 
 // Complete table, not unique pieces
-static std::vector<char> buildCompletePermutationPruningTable3(std::vector<int> solved, MoveList moves, string setname, std::vector<int> ignore)
+static std::vector<char> buildCompletePermutationPruningTable3(std::vector<int> solved, MoveList moves, string setname, std::vector<int> ignore, std::vector<int>& moveTable, std::vector<int>& costs, std::ostream& out)
 {
-	std::cout << "Building pruning for " << setname << " permutation\n";
+	int nMoves = moves.size();
+	out << "Building pruning for " << setname << " permutation\n";
 	std::vector<char> table;
 	int vector_size = solved.size();
-	MoveList::iterator iter;
 	int tablesize = combinations(solved);
 		
 	table.resize(tablesize);
 	for (int i = 0; i < tablesize; i++)
 		table[i] = -1;
 		
-	std::cout << "tablesize " << tablesize << "\n";
+	out << "tablesize " << tablesize << "\n";
 
 	table[pVector3Index(solved)] = 0; // Put solved position in table
+	std::vector<int> inverses = moveInverses(moveTable, nMoves);
 
 	int len = 0;
 	int c;
+	int last = 0; // the largest value given out so far
+	std::vector<long long> count(128, 0); // entries with each value
 	do
 	{
-		c = 0;
-		for (int p = 0; p < tablesize; p++){
-			if (table[p] == len){
-				for (iter = moves.begin(); iter != moves.end(); iter++){
-					// FIX, assumes that inverses to all moves are also one move
-					int q = pVector3Index(applySubmoveP(pIndex3Array(p, solved), iter->second.state[setname].permutation, vector_size), vector_size);
-					// FIX
-					if (table[q] == -1){
-						table[q] = len + 1;
-						c++;
-					}
+		if (expandBackward(inverses, count, len, tablesize))
+			backwardLayer(table, moveTable, inverses, costs, len, count, last);
+		else {
+			#pragma omp parallel
+			{
+				std::vector<long long> threadCount(count.size(), 0);
+				int threadLast = last;
+				#pragma omp for schedule(dynamic, 4096)
+				for (int p = 0; p < tablesize; p++){
+					if (table[p] == len){
+						int m = 0;
+						for (MoveList::iterator iter = moves.begin(); iter != moves.end(); iter++, m++){
+							// FIX, assumes that inverses to all moves are also one move
+							int q;
+							if (!moveTable.empty())
+								q = moveTable[p * nMoves + m];
+							else
+								q = pVector3Index(applySubmoveP(pIndex3Array(p, solved), iter->second.state[setname].permutation, vector_size), vector_size);
+							// FIX
+							lowerEntry(table[q], len + moveCost(costs, m), threadCount, threadLast);
+						}
+					}      
 				}
-			}      
+				mergeCounts(count, last, threadCount, threadLast);
+			}
 		}
 		len++;
+		c = count[len];
 		if (ignore.empty())
-			std::cout << c << " positions at depth " << len << "\n"; 
-	}while(c > 0);
+			out << c << " positions at depth " << len << "\n"; 
+	}while(len <= last);
 	
 	if (!ignore.empty()){
 		c = 0;
@@ -531,35 +1103,51 @@ static std::vector<char> buildCompletePermutationPruningTable3(std::vector<int>
 				delete tmp_p;
 			}
 		}
-		std::cout << c << " solved positions.\n";
+		out << c << " solved positions.\n";
 
 		int len = 0;
 		int c;
+		int last = 0; // the largest value given out so far
+		std::vector<long long> count(128, 0); // entries with each value
 		do
 		{
-			c = 0;
-			for (int p = 0; p < tablesize; p++){
-				if (table[p] == len){
-					for (iter = moves.begin(); iter != moves.end(); iter++){
-						// FIX, assumes that inverses to all moves are also one move
-						int q = pVector3Index(applySubmoveP(pIndex3Array(p, solved), iter->second.state[setname].permutation, vector_size), vector_size);
-						// FIX
-						if (table[q] == -1){
-							table[q] = len + 1;
-							c++;
-						}
+			if (expandBackward(inverses, count, len, tablesize))
+				backwardLayer(table, moveTable, inverses, costs, len, count, last);
+			else {
+				#pragma omp parallel
+				{
+					std::vector<long long> threadCount(count.size(), 0);
+					int threadLast = last;
+					#pragma omp for schedule(dynamic, 4096)
+					for (int p = 0; p < tablesize; p++){
+						if (table[p] == len){
+							int m = 0;
+							for (MoveList::iterator iter = moves.begin(); iter != moves.end(); iter++, m++){
+								// FIX, assumes that inverses to all moves are also one move
+								int q;
+								if (!moveTable.empty())
+									q = moveTable[p * nMoves + m];
+								else
+									q = pVector3Index(applySubmoveP(pIndex3Array(p, solved), iter->second.state[setname].permutation, vector_size), vector_size);
+								// FIX
+								lowerEntry(table[q], len + moveCost(costs, m), threadCount, threadLast);
+							}
+						}      
 					}
-				}      
+					mergeCounts(count, last, threadCount, threadLast);
+				}
 			}
 			len++;
-			std::cout << c << " positions at depth " << len << "\n"; 
-		}while(c > 0);
+			c = count[len];
+			out << c << " positions at depth " << len << "\n"; 
+		}while(len <= last);
 
 	}
 	return table;
 }
 
-static std::map<std::vector<long long>, char> buildPartialOrientationPruningTable(std::vector<int> solved, MoveList moves, string setname, int omod, std::vector<int> ignore)
+// Positions that are symmetric to each other share one entry (see canonicalKey)
+static std::map<std::vector<long long>, char> buildPartialOrientationPruningTable(std::vector<int> solved, MoveList moves, string setname, int omod, std::vector<int> ignore, std::vector<setsymmetry>& symmetries, std::vector<int>& costs)
 {
 	std::cout << "Building partial pruning table for " << setname << " orientation.\n";
 	std::map<std::vector<long long>, char> table;
@@ -567,25 +1155,29 @@ static std::map<std::vector<long long>, char> buildPartialOrientationPruningTabl
 	std::map<std::vector<long long>, char>::iterator iter2, iter3;
 	MoveList::iterator iter;
 
-	table[packVector(solved)] = 0; // Put solved position in table
+	table[canonicalKey(solved, symmetries, false)] = 0; // Put solved position in table
 
 	int len = 0;
 	int c, tot_c;
 	tot_c = 0;
 	bool abort = false;
+	int last = 0; // the largest value given out so far
+	int final = 0; // the largest value that is known to be right in old_table
+	std::vector<long long> count(128, 0); // entries with each value
 
 	do
 	{
-		c = 0;
-		for (iter2 = table.begin(); iter2 != table.end(); iter++){
+		for (iter2 = table.begin(); iter2 != table.end(); iter2++){
 			if (iter2->second == len && !abort){
 				std::vector<int> pos = unpackVector(iter2->first);
-				for (iter = moves.begin(); iter != moves.end(); iter++){
+				pos.resize(solved.size()); // unpacking drops trailing zeros
+				int m = 0;
+				for (iter = moves.begin(); iter != moves.end(); iter++, m++){
 					std::vector<int> q = applySubmoveO(pos, iter->second.state[setname].orientation, iter->second.state[setname].permutation, iter->second.state[setname].size, omod);
-					std::vector<long long> newpos = packVector(q);
-					if (table.find(newpos) == table.end()){
-						table[newpos] = len + 1;
-						c++;
+					std::vector<long long> newpos = canonicalKey(q, symmetries, false);
+					std::pair<std::map<std::vector<long long>, char>::iterator, bool> added = table.insert(std::make_pair(newpos, (char)-1));
+					lowerEntry(added.first->second, len + moveCost(costs, m), count, last);
+					if (added.second){
 						tot_c++;
 						if (tot_c >= MAX_PARTIAL_ORIENTATION_TABLE_SIZE){
 							abort = true;
@@ -595,22 +1187,26 @@ static std::map<std::vector<long long>, char> buildPartialOrientationPruningTabl
 				}
 			}
 		}
-		if (!abort)
+		if (!abort){
 			old_table = table;
+			final = len + 1;
+		}
 		len++;
+		c = count[len];
 		std::cout << c << " positions at depth " << len << "\n"; 
 			
-	}while(c > 0 && !abort);
+	}while(len <= last && !abort);
 	if (abort){
 		std::cout << "Too many positions at depth " << len << ", removing.\n";
-		return old_table;
+		return keepFinal(old_table, final);
 	}
 	
 	return table;
 }
 
 
-static std::map<std::vector<long long>, char> buildPartialPermutationPruningTable(std::vector<int> solved, MoveList moves, string setname, std::vector<int> ignore)
+// Positions that are symmetric to each other share one entry (see canonicalKey)
+static std::map<std::vector<long long>, char> buildPartialPermutationPruningTable(std::vector<int> solved, MoveList moves, string setname, std::vector<int> ignore, std::vector<setsymmetry>& symmetries, std::vector<int>& costs)
 {
 	std::cout << "Building partial pruning for " << setname << " permutation.\n";
 	std::map<std::vector<long long>, char> table;
@@ -619,7 +1215,7 @@ static std::map<std::vector<long long>, char> buildPartialPermutationPruningTabl
 	std::map<std::vector<long long>, char>::iterator iter2;
 	MoveList::iterator iter;
 
-	std::vector<long long> first_key = packVector(solved);
+	std::vector<long long> first_key = canonicalKey(solved, symmetries, true);
 	table[first_key] = 0; // Put solved position in table
 
 	if (!ignore.empty()){
@@ -644,7 +1240,7 @@ static std::map<std::vector<long long>, char> buildPartialPermutationPruningTabl
 					v++;
 				}
 			}
-			table[packVector(tmp_perm)] = 0;
+			table[canonicalKey(tmp_perm, symmetries, true)] = 0;
 		}
 		std::cout << table.size() << " solved positions.\n";
 	}
@@ -653,18 +1249,21 @@ static std::map<std::vector<long long>, char> buildPartialPermutationPruningTabl
 	int c, tot_c;
 	tot_c = 0;
 	bool abort = false;
+	int last = 0; // the largest value given out so far
+	int final = 0; // the largest value that is known to be right in old_table
+	std::vector<long long> count(128, 0); // entries with each value
 	do
 	{
-		c = 0;
 		for (iter2 = table.begin(); iter2 != table.end(); iter2++){
 			if (iter2->second == len && !abort){
 				std::vector<int> pos = unpackVector(iter2->first);
-				for (iter = moves.begin(); iter != moves.end(); iter++){
+				int m = 0;
+				for (iter = moves.begin(); iter != moves.end(); iter++, m++){
 					std::vector<int> q = applySubmoveP(pos , iter->second.state[setname].permutation, iter->second.state[setname].size);
-					std::vector<long long> newpos = packVector(q);
-					if (table.find(newpos) == table.end()){
-						table[newpos] = len + 1;
-						c++;
+					std::vector<long long> newpos = canonicalKey(q, symmetries, true);
+					std::pair<std::map<std::vector<long long>, char>::iterator, bool> added = table.insert(std::make_pair(newpos, (char)-1));
+					lowerEntry(added.first->second, len + moveCost(costs, m), count, last);
+					if (added.second){
 						tot_c++;
 						if (tot_c >= MAX_PARTIAL_PERMUTATION_TABLE_SIZE){
 							abort = true;
@@ -674,20 +1273,141 @@ static std::map<std::vector<long long>, char> buildPartialPermutationPruningTabl
 				}
 			}      
 		}
-		if (!abort)
+		if (!abort){
 			old_table = table;
+			final = len + 1;
+		}
 		len++;
+		c = count[len];
 		std::cout << c << " positions at depth " << len << "\n";
-	}while(c > 0 && !abort);
+	}while(len <= last && !abort);
 	
 	if (abort){
 		std::cout << "Too many positions at depth " << len << ", removing.\n";
-		return old_table;
+		return keepFinal(old_table, final);
 	}
 
 	return table;
 }
 
+// What it costs to do move m (counting the moves of the MoveList in order), by
+// costs; with no costs, every move costs 1
+static inline int moveCost(std::vector<int>& costs, int m){
+	return costs.empty() ? 1 : costs[m];
+}
+
+// Lower a table entry to value, unless it already has a value that is no
+// larger. count holds the number of entries with each value, and last the
+// largest value given out. Values from PHASE_UNREACHABLE up don't fit in an
+// entry, so those positions are left out. Threads can lower the same entry at
+// once, each with counts of its own (see mergeCounts).
+static inline void lowerEntry(char& entry, int value, std::vector<long long>& count, int& last){
+	if (value >= PHASE_UNREACHABLE)
+		return;
+	char old = entry;
+	while (old == -1 || old > value) {
+		if (__sync_bool_compare_and_swap(&entry, old, (char)value)) {
+			if (old != -1)
+				count[old]--;
+			count[value]++;
+			if (value > last)
+				last = value;
+			return;
+		}
+		old = entry;
+	}
+}
+
+// The move that undoes each move in a move table, or nothing if some move has
+// no such move; then the table can't be built backwards
+static std::vector<int> moveInverses(std::vector<int>& moveTable, int nMoves){
+	if (moveTable.empty())
+		return std::vector<int>();
+	std::vector<std::vector<int>*> moveTables(1, &moveTable);
+	return jointInverses(moveTables, nMoves);
+}
+
+// The same for a joint table: a move that undoes each move in all the parts
+static std::vector<int> jointInverses(std::vector<std::vector<int>*>& moveTables, int nMoves){
+	std::vector<int> inverses;
+	for (int m = 0; m < nMoves; m++){
+		int found = -1;
+		for (int n = 0; n < nMoves && found == -1; n++){
+			bool undoes = true;
+			for (unsigned int k = 0; k < moveTables.size() && undoes; k++){
+				std::vector<int>& moveTable = *moveTables[k];
+				int tablesize = moveTable.size() / nMoves;
+				for (int p = 0; p < tablesize && undoes; p++)
+					undoes = (moveTable[moveTable[p * nMoves + m] * nMoves + n] == p);
+			}
+			if (undoes)
+				found = n;
+		}
+		if (found == -1)
+			return std::vector<int>();
+		inverses.push_back(found);
+	}
+	return inverses;
+}
+
+// Is it cheaper to build layer len backwards, from the entries that are still
+// to be filled, than forwards from the entries with value len? That is when
+// there are fewer of them (counting the entries filled so far from count).
+static bool expandBackward(std::vector<int>& inverses, std::vector<long long>& count, int len, long long tablesize){
+	if (inverses.empty())
+		return false;
+	long long filled = 0;
+	for (unsigned int v = 0; v < count.size(); v++)
+		filled += count[v];
+	return count[len] > tablesize - filled;
+}
+
+// Build layer len of a table backwards: each entry that can still come down
+// looks for a neighbour with value len. Move m takes that neighbour to the
+// entry if the inverse of m takes the entry to it. On all threads, like the
+// forward layers.
+static void backwardLayer(std::vector<char>& table, std::vector<int>& moveTable, std::vector<int>& inverses, std::vector<int>& costs, int len, std::vector<long long>& count, int& last){
+	int nMoves = inverses.size();
+	int tablesize = table.size();
+	#pragma omp parallel
+	{
+		std::vector<long long> threadCount(count.size(), 0);
+		int threadLast = last;
+		#pragma omp for schedule(dynamic, 4096)
+		for (int q = 0; q < tablesize; q++){
+			if (table[q] != -1 && table[q] <= len + 1)
+				continue;
+			for (int m = 0; m < nMoves; m++){
+				if (table[moveTable[q * nMoves + inverses[m]]] == len)
+					lowerEntry(table[q], len + moveCost(costs, m), threadCount, threadLast);
+			}
+		}
+		mergeCounts(count, last, threadCount, threadLast);
+	}
+}
+
+// Add the counts of one thread to the ones of the table (see lowerEntry)
+static void mergeCounts(std::vector<long long>& count, int& last, std::vector<long long>& threadCount, int threadLast){
+	#pragma omp critical (mergeCounts)
+	{
+		for (unsigned int v = 0; v < count.size(); v++)
+			count[v] += threadCount[v];
+		if (threadLast > last)
+			last = threadLast;
+	}
+}
+
+// A partial table cut short, with only the values that are known to be right.
+// With moves of different costs, a larger value may still have come down.
+static std::map<std::vector<long long>, char> keepFinal(std::map<std::vector<long long>, char>& table, int final){
+	std::map<std::vector<long long>, char> kept;
+	std::map<std::vector<long long>, char>::iterator iter;
+	for (iter = table.begin(); iter != table.end(); iter++)
+		if (iter->second <= final)
+			kept.insert(kept.end(), *iter);
+	return kept;
+}
+
 static int maxDepth(std::map<std::vector<long long>, char> table){
 	int maxdepth = 0;
 	std::map<std::vector<long long>, char>::iterator iter;
@@ -722,60 +1442,263 @@ static void updateDatasets(PieceTypes& datasets, PruneTable& tables)
 	}
 }
 
-static bool prune(Position& state, int depth, PieceTypes& datasets, PruneTable& prunetables){
-	Position::iterator iter2;
-	for (iter2 = state.begin(); iter2 != state.end(); iter2++){
+// The least depth prune lets through, a lower bound on the moves the position needs
+static int pruneBound(unsigned char* state, int* coords, CompiledPuzzle& puzzle, std::vector<std::vector<int> >& order){
+	int depth = 0;
+	while (pruningTable(state, coords, depth, puzzle, order, NULL, NULL) >= 0)
+		depth++;
+	return depth;
+}
 
-		// Orientation pruning
-		if (datasets[iter2->first].otabletype == TABLE_TYPE_COMPLETE){
-			int index = oVector2Index(iter2->second.orientation, iter2->second.size, datasets[iter2->first].omod);
-			if (prunetables[iter2->first].orientation[index]  > depth){
-				return true;
+// The pruning table that shows depth is not enough for this position: 2 * set
+// for a set's orientation table, 2 * set + 1 for its permutation table, and
+// 2 * sets + j for joint table j. -1 if none of them do. The tables are looked at in the order given for this depth
+// (see orderPruningTables); checked, if given, counts how often each one is.
+// excess, if given, holds the least excess seen so far, and gets how much more
+// depth the tables ask for: the largest of their bounds, so that it doesn't
+// depend on the order. The tables after the one that cuts are only looked at
+// while that is below the least excess, as it can't lower it otherwise.
+static int pruningTable(unsigned char* state, int* coords, int depth, CompiledPuzzle& puzzle, std::vector<std::vector<int> >& order, long long* checked, int* excess){
+	if (depth >= (int)order.size())
+		return -1;
+	std::vector<int>& tables = order[depth];
+	for (unsigned int t = 0; t < tables.size(); t++){
+		if (checked != NULL)
+			checked[tables[t]]++;
+		int bound = tableBound(tables[t], state, coords, depth, puzzle);
+		if (bound > depth){
+			if (excess != NULL){
+				for (unsigned int u = t + 1; u < tables.size() && bound - depth < *excess; u++)
+					bound = std::max(bound, tableBound(tables[u], state, coords, depth, puzzle));
+				*excess = bound - depth;
 			}
+			return tables[t];
 		}
-		else if (datasets[iter2->first].otabletype == TABLE_TYPE_PARTIAL){
-			std::vector<long long> index = packVector(iter2->second.orientation, iter2->second.size);
-			
-			if (prunetables[iter2->first].partialorientation_depth >= depth){
-				if (prunetables[iter2->first].partialorientation.count(index) == 1){ // If the position exist in the table then...
-					if (prunetables[iter2->first].partialorientation[index] > depth){
-						return true;
-					}                         
-				}
-				else{
-					return true;
-				}
+	}
+	return -1;
+}
+
+// Do the orientation tables of these sets show depth is not enough for the
+// position whose inverse this is? checked, if given, counts the lookups, and
+// excess works like in pruningTable.
+static bool inverseCuts(unsigned char* inverse, int depth, CompiledPuzzle& puzzle, std::vector<int>& sets, long long* checked, int* excess){
+	for (unsigned int k = 0; k < sets.size(); k++){
+		if (checked != NULL)
+			(*checked)++;
+		int bound = tableBound(2 * sets[k], inverse, NULL, depth, puzzle);
+		if (bound > depth){
+			if (excess != NULL){
+				for (unsigned int u = k + 1; u < sets.size() && bound - depth < *excess; u++)
+					bound = std::max(bound, tableBound(2 * sets[u], inverse, NULL, depth, puzzle));
+				*excess = bound - depth;
 			}
+			return true;
 		}
-		// Permutation pruning
-		if (datasets[iter2->first].ptabletype == TABLE_TYPE_COMPLETE && datasets[iter2->first].uniqueperm){
-			int index = pVector2Index(iter2->second.permutation, iter2->second.size);
-			if (prunetables[iter2->first].permutation[index]  > depth){
-				return true;
-			}
+	}
+	return false;
+}
+
+// The least depth this one pruning table says the position needs. Without
+// coords, the coordinates are computed from the state. Partial tables that
+// can't cut anything off at this depth aren't looked at, and give 0.
+static int tableBound(int table, unsigned char* state, int* coords, int depth, CompiledPuzzle& puzzle){
+	int nSets = puzzle.sets.size();
+	if (table >= 2 * nSets)
+		return jointBound(puzzle.joints[table - 2 * nSets], state, coords, puzzle);
+	compiledset& set = puzzle.sets[table / 2];
+	subprune& tables = *set.tables;
+
+	// Orientation pruning
+	if (table % 2 == 0){
+		unsigned char* orientation = state + set.ooffset;
+		if (set.ocoord != -1 && coords != NULL){
+			// kept up to date by the move tables
+			return (*puzzle.coords[set.ocoord].table)[coords[set.ocoord]];
 		}
-		else if (datasets[iter2->first].ptabletype == TABLE_TYPE_COMPLETE && !datasets[iter2->first].uniqueperm){
-			long long index = pVector3Index(iter2->second.permutation, iter2->second.size);
-			if (prunetables[iter2->first].permutation[index]  > depth){
-				return true;
+		else if (set.otabletype == TABLE_TYPE_COMPLETE){
+			int index = oVector2Index(orientation, set.size, set.omod);
+			return tables.orientation[index];
+		}
+		else if (set.otabletype == TABLE_TYPE_PARTIAL){
+			if (tables.partialorientation_depth >= depth){
+				std::vector<long long> index = canonicalKey(orientation, set.size, set.symmetries, false);
+				std::map<std::vector<long long>, char>::iterator found = tables.partialorientation.find(index);
+				if (found != tables.partialorientation.end()) // If the position exist in the table then...
+					return found->second;
+				return tables.partialorientation_depth + 1;
 			}
 		}
-		else if (datasets[iter2->first].ptabletype == TABLE_TYPE_PARTIAL){;
-			std::vector<long long> index = packVector(iter2->second.permutation, iter2->second.size);
+		return 0;
+	}
 
-			if (prunetables[iter2->first].partialpermutation_depth >= depth){
-				if (prunetables[iter2->first].partialpermutation.find(index) != prunetables[iter2->first].partialpermutation.end()){
-					if (prunetables[iter2->first].partialpermutation[index] > depth){
-						return true;
-					}
+	// Permutation pruning
+	unsigned char* permutation = state + set.poffset;
+	if (set.pcoord != -1 && coords != NULL){
+		return (*puzzle.coords[set.pcoord].table)[coords[set.pcoord]];
+	}
+	else if (set.ptabletype == TABLE_TYPE_COMPLETE && set.uniqueperm){
+		int index = pVector2Index(permutation, set.size);
+		return tables.permutation[index];
+	}
+	else if (set.ptabletype == TABLE_TYPE_COMPLETE && !set.uniqueperm){
+		long long index = pVector3Index(permutation, set.size);
+		return tables.permutation[index];
+	}
+	else if (set.ptabletype == TABLE_TYPE_PARTIAL){
+		if (tables.partialpermutation_depth >= depth){
+			std::vector<long long> index = canonicalKey(permutation, set.size, set.symmetries, true);
+			std::map<std::vector<long long>, char>::iterator found = tables.partialpermutation.find(index);
+			if (found != tables.partialpermutation.end())
+				return found->second;
+			return tables.partialpermutation_depth + 1;
+		}
+	}
+	return 0;
+}
+
+// The value of a joint table for a position. Without coords, the coordinates
+// of its parts are computed from the state.
+static inline int jointBound(compiledjoint& joint, unsigned char* state, int* coords, CompiledPuzzle& puzzle){
+	long long index = 0;
+	for (unsigned int k = 0; k < joint.coords.size(); k++)
+		index += (coords != NULL ? coords[joint.coords[k]] : coordValue(state, puzzle, joint.coords[k])) * joint.stride[k];
+	return (*joint.table)[index];
+}
+
+// Roughly how long a table takes to look at, compared to a coordinate that the
+// move tables keep up to date. A joint table is mostly too large for the cache.
+static double pruneCost(int table, CompiledPuzzle& puzzle){
+	if (table >= 2 * (int)puzzle.sets.size())
+		return 2;
+	compiledset& set = puzzle.sets[table / 2];
+	bool orientation = (table % 2 == 0);
+	if ((orientation ? set.ocoord : set.pcoord) != -1)
+		return 1;
+	if ((orientation ? set.otabletype : set.ptabletype) == TABLE_TYPE_PARTIAL)
+		return 16;
+	if (orientation)
+		return 2;
+	return set.uniqueperm ? 4 : 6;
+}
+
+// Estimate, from the values in each table, how many positions it cuts off with
+// each depth left, as if positions were picked at random. Tables the puzzle
+// doesn't have get no estimates.
+static void estimatePruneRates(CompiledPuzzle& puzzle){
+	int nSets = puzzle.sets.size();
+	puzzle.pruneRate.assign(2 * nSets + puzzle.joints.size(), std::vector<double>());
+	for (int table = 0; table < (int)puzzle.pruneRate.size(); table++){
+		std::vector<char>* complete = NULL;
+		bool orientation = (table % 2 == 0);
+		int type = TABLE_TYPE_COMPLETE;
+		if (table >= 2 * nSets)
+			complete = puzzle.joints[table - 2 * nSets].table;
+		else {
+			compiledset& set = puzzle.sets[table / 2];
+			type = orientation ? set.otabletype : set.ptabletype;
+			complete = orientation ? &set.tables->orientation : &set.tables->permutation;
+		}
+		if (type == TABLE_TYPE_NONE)
+			continue;
+
+		// how many entries have each value
+		std::vector<long long> count(128, 0);
+		long long total = 0;
+		int partialDepth = -1;
+		if (type == TABLE_TYPE_COMPLETE){
+			std::vector<char>& values = *complete;
+			for (unsigned int i = 0; i < values.size(); i++)
+				if (values[i] >= 0){
+					count[values[i]]++;
+					total++;
 				}
-				else{
-					return true;
+		} else {
+			subprune& tables = *puzzle.sets[table / 2].tables;
+			std::map<std::vector<long long>, char>& values = orientation ? tables.partialorientation : tables.partialpermutation;
+			std::map<std::vector<long long>, char>::iterator iter;
+			for (iter = values.begin(); iter != values.end(); iter++)
+				if (iter->second >= 0){
+					count[iter->second]++;
+					total++;
 				}
-			}
+			partialDepth = orientation ? tables.partialorientation_depth : tables.partialpermutation_depth;
+		}
+
+		// the fraction above each depth; a partial table cuts off everything it
+		// doesn't have up to its depth, so it is always worth a look until then
+		std::vector<double>& rate = puzzle.pruneRate[table];
+		long long below = 0;
+		for (int depth = 0; depth < 128 && below < total; depth++){
+			below += count[depth];
+			rate.push_back((total - below) / (double)total);
+		}
+		for (int depth = 0; depth <= partialDepth; depth++){
+			if (depth >= (int)rate.size())
+				rate.push_back(0);
+			if (rate[depth] <= 0)
+				rate[depth] = 1.0 / (total + 1);
 		}
+		while (!rate.empty() && rate.back() <= 0)
+			rate.pop_back();
+	}
+}
+
+// Put the pruning tables that can cut anything off at each depth in the order
+// prune should look at them: most positions cut off for the time taken first,
+// or the order of the sets (joint tables, then coordinates first) with
+// PRUNE_ORDER_FIXED. Tables with a 1 in skip are left out.
+static void orderPruningTables(CompiledPuzzle& puzzle, int mode, std::vector<char>& skip, std::vector<std::vector<int> >& order){
+	int depths = 0;
+	for (unsigned int table = 0; table < puzzle.pruneRate.size(); table++)
+		if (!skip[table])
+			depths = std::max(depths, (int)puzzle.pruneRate[table].size());
+	order.assign(depths, std::vector<int>());
+
+	std::vector<int> fixed;
+	for (unsigned int j = 0; j < puzzle.joints.size(); j++)
+		fixed.push_back(2 * puzzle.sets.size() + j);
+	for (unsigned int c = 0; c < puzzle.coords.size(); c++)
+		if (puzzle.coords[c].table != NULL)
+			fixed.push_back(2 * puzzle.coords[c].set + (puzzle.coords[c].orientation ? 0 : 1));
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++){
+		if (puzzle.sets[s].ocoord == -1)
+			fixed.push_back(2 * s);
+		if (puzzle.sets[s].pcoord == -1)
+			fixed.push_back(2 * s + 1);
+	}
+
+	for (int depth = 0; depth < depths; depth++){
+		std::vector<std::pair<double, int> > tables;
+		for (unsigned int f = 0; f < fixed.size(); f++){
+			int table = fixed[f];
+			if (skip[table] || depth >= (int)puzzle.pruneRate[table].size())
+				continue;
+			double score = puzzle.pruneRate[table][depth] / pruneCost(table, puzzle);
+			tables.push_back(std::pair<double, int>((mode == PRUNE_ORDER_FIXED) ? f : -score, table));
+		}
+		std::sort(tables.begin(), tables.end());
+		for (unsigned int t = 0; t < tables.size(); t++)
+			order[depth].push_back(tables[t].second);
+	}
+}
+
+// Sort the tables for each depth again by how many of the positions they were
+// asked about they actually cut off (tables that were never asked keep the
+// estimate), for PRUNE_ORDER_ADAPTIVE
+static void adaptPruningOrder(CompiledPuzzle& puzzle, SearchStats& stats, std::vector<std::vector<int> >& order){
+	for (unsigned int depth = 0; depth < order.size(); depth++){
+		std::vector<std::pair<double, int> > tables;
+		for (unsigned int t = 0; t < order[depth].size(); t++){
+			int table = order[depth][t];
+			double rate = puzzle.pruneRate[table][depth];
+			if (stats.checked[table] > 0)
+				rate = stats.pruned[table] / (double)stats.checked[table];
+			tables.push_back(std::pair<double, int>(-rate / pruneCost(table, puzzle), table));
+		}
+		std::sort(tables.begin(), tables.end());
+		for (unsigned int t = 0; t < tables.size(); t++)
+			order[depth][t] = tables[t].second;
 	}
-	return false;
 }
 
 #endif
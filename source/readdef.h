@@ -198,6 +198,45 @@ public:
 					}
 					blocks.push_back(tmp_block);
 				}
+				else if (command == "PruneTable"){
+					string line, part;
+					getline(fin, line);
+					std::istringstream input(line);
+					JointTable joint;
+					while (input >> part){
+						size_t bracket = part.find('[');
+						string name = part.substr(0, bracket);
+						size_t dot = name.find('.');
+						string setname = name.substr(0, dot);
+						string kind = (dot == string::npos) ? "" : name.substr(dot + 1);
+						if (datasets.find(setname) == datasets.end()) {
+							std::cerr << "Set " << setname << " used in PruneTable is not previously declared.\n";
+							exit(-1);
+						}
+						if (kind != "perm" && kind != "orient") {
+							std::cerr << "Part " << part << " of PruneTable should be " << setname << ".perm or " << setname << ".orient\n";
+							exit(-1);
+						}
+						JointPart newPart;
+						newPart.name = part;
+						newPart.set = setname;
+						newPart.orientation = (kind == "orient");
+						if (bracket != string::npos)
+							newPart.pieces = readPieceList(part.substr(bracket), datasets[setname].size, part);
+						for (unsigned int k = 0; k < joint.parts.size(); k++)
+							if (joint.parts[k].set == setname && joint.parts[k].orientation == newPart.orientation && joint.parts[k].pieces == newPart.pieces) {
+								std::cerr << "Part " << part << " used twice in PruneTable.\n";
+								exit(-1);
+							}
+						joint.parts.push_back(newPart);
+						joint.name += (joint.name.empty() ? "" : " ") + part;
+					}
+					if (joint.parts.empty()) {
+						std::cerr << "PruneTable needs at least one part.\n";
+						exit(-1);
+					}
+					joints.push_back(joint);
+				}
 				else if (command == "MoveLimits"){
 					std::cout << "MoveLimits command has been moved to scramble file!\n";
 					string newmove;
@@ -273,6 +312,10 @@ public:
 		return forbidden;
 	}
 
+	std::set<MovePair> getCommutingPairs(){
+		return commuting;
+	}
+
 	Position getIgnore(){
 		return ignore;
 	}
@@ -280,6 +323,10 @@ public:
 	std::vector<Block> getBlocks(){
 		return blocks;
 	}
+
+	JointTables getJointTables(){
+		return joints;
+	}
 	
 	std::map<string, int> getMoveLimits() {
 		return moveLimits;
@@ -294,9 +341,39 @@ private:
 	MoveList moves; // Possible moves of the puzzle
 	std::vector<int> parentMoves; // IDs of parent moves
 	std::set<MovePair> forbidden;
+	std::set<MovePair> commuting; // commuting parent moves (a, b), where a followed by b is the order we skip
 	std::vector<Block> blocks;
+	JointTables joints; // from the PruneTable commands, not built yet
 	std::map<string, int> moveLimits; // limits on # of moves
 	
+	// Read the pieces of a PruneTable part, such as [1-4,7]
+	std::vector<int> readPieceList(string list, int size, string part) {
+		std::set<int> pieces;
+		std::istringstream input(list);
+		char c;
+		input >> c;
+		while (c == '[' || c == ',') {
+			int first, last;
+			input >> first;
+			last = first;
+			if (input.peek() == '-') {
+				input >> c >> last;
+			}
+			if (input.fail() || first < 1 || last > size || first > last) {
+				std::cerr << "Pieces of " << part << " in PruneTable should be numbers from 1 to " << size << ", like [1-4,7].\n";
+				exit(-1);
+			}
+			for (int p = first; p <= last; p++)
+				pieces.insert(p);
+			input >> c;
+		}
+		if (input.fail() || c != ']' || input.peek() != EOF) {
+			std::cerr << "Pieces of " << part << " in PruneTable should be numbers from 1 to " << size << ", like [1-4,7].\n";
+			exit(-1);
+		}
+		return std::vector<int>(pieces.begin(), pieces.end());
+	}
+
 	// Add all powers of this move
 	void addPowers(fullmove move, int parentid, PieceTypes& datasets) {
 		std::vector<int> moveGroup;
@@ -380,6 +457,12 @@ private:
 				ji = mergeMoves(moves[parentMoves[j]].state, moves[parentMoves[i]].state, datasets);
 				if (isEqual(ij, ji, datasets)) {
 					
+					// remember the pair, in the order we skip
+					if (forbidden.find(MovePair(parentMoves[j], parentMoves[i])) == forbidden.end())
+						commuting.insert(MovePair(parentMoves[i], parentMoves[j]));
+					else
+						commuting.insert(MovePair(parentMoves[j], parentMoves[i]));
+
 					// if so, forbid any move with parent i followed by any move with parent j
 					for (iter1 = moves.begin(); iter1 != moves.end(); iter1++) {
 						if (iter1->second.parentID == parentMoves[i]) {
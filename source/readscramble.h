@@ -30,10 +30,17 @@ public:
 		int current_max = 999;
 		int current_slack = 0;
 		int current_metric = 0;
+		int current_mode = SEARCH_MODE_IDA;
+		int current_max_solutions = 0;
+		long long current_node_limit = 0;
+		double current_time_limit = 0;
+		int current_phases = -1;
 		Position state;
 		Position ignore;
 		string name;
 		moveLimits.clear();
+		moveCosts.clear();
+		metricIndex(0, moves); // HTM is always metric 0
 	   
 		while(!fin.eof()){
 			string command;
@@ -152,7 +159,12 @@ public:
 				scramble.ignore = ignore;
 				scramble.max_depth = current_max;
 				scramble.slack = current_slack;
-				scramble.metric = current_metric;
+				scramble.metric = metricIndex(current_metric, moves);
+				scramble.searchMode = current_mode;
+				scramble.maxSolutions = current_max_solutions;
+				scramble.nodeLimit = current_node_limit;
+				scramble.timeLimit = current_time_limit;
+				scramble.phases = current_phases;
 				scramble.printState = 0;
 				scramble.moveLimits = std::vector<MoveLimit>();
 				for (unsigned int i=0; i<moveLimits.size(); i++) {
@@ -230,7 +242,12 @@ public:
 				scramble.ignore = ignore;
 				scramble.max_depth = current_max;
 				scramble.slack = current_slack;
-				scramble.metric = current_metric;
+				scramble.metric = metricIndex(current_metric, moves);
+				scramble.searchMode = current_mode;
+				scramble.maxSolutions = current_max_solutions;
+				scramble.nodeLimit = current_node_limit;
+				scramble.timeLimit = current_time_limit;
+				scramble.phases = current_phases;
 				scramble.printState = 1;
 				scramble.moveLimits = std::vector<MoveLimit>();
 				for (unsigned int i=0; i<moveLimits.size(); i++) {
@@ -313,7 +330,12 @@ public:
 				scramble.ignore = ignore;
 				scramble.max_depth = current_max;
 				scramble.slack = current_slack;
-				scramble.metric = current_metric;
+				scramble.metric = metricIndex(current_metric, moves);
+				scramble.searchMode = current_mode;
+				scramble.maxSolutions = current_max_solutions;
+				scramble.nodeLimit = current_node_limit;
+				scramble.timeLimit = current_time_limit;
+				scramble.phases = current_phases;
 				scramble.printState = 1;
 				scramble.moveLimits = std::vector<MoveLimit>();
 				for (unsigned int i=0; i<moveLimits.size(); i++) {
@@ -345,6 +367,143 @@ public:
 			else if (command == "HTM") {
 				current_metric = 0;
 			}
+			// MaxSolutions - stop after this many solutions
+			else if (command == "MaxSolutions"){
+				fin >> current_max_solutions;
+				if (fin.fail() || current_max_solutions < 0){
+					std::cerr << "Error reading MaxSolutions\n";
+					exit(-1);
+				}
+			}
+			// FirstOnly - stop at the first solution
+			else if (command == "FirstOnly"){
+				current_max_solutions = 1;
+			}
+			// NodeLimit - stop after this many nodes
+			else if (command == "NodeLimit"){
+				fin >> current_node_limit;
+				if (fin.fail() || current_node_limit < 0){
+					std::cerr << "Error reading NodeLimit\n";
+					exit(-1);
+				}
+			}
+			// TimeLimit - stop after this many seconds
+			else if (command == "TimeLimit"){
+				fin >> current_time_limit;
+				if (fin.fail() || current_time_limit < 0){
+					std::cerr << "Error reading TimeLimit\n";
+					exit(-1);
+				}
+			}
+			// SearchMode - how to search for the solutions
+			else if (command == "SearchMode") {
+				string mode;
+				fin >> mode;
+				if (mode == "IDA")
+					current_mode = SEARCH_MODE_IDA;
+				else if (mode == "MITM")
+					current_mode = SEARCH_MODE_MITM;
+				else {
+					std::cerr << "Unknown SearchMode " << mode << " (use IDA or MITM).\n";
+					exit(-1);
+				}
+			}
+			// Phases - solve the following scrambles in these phases
+			else if (command == "Phases"){
+				std::vector<PhaseDef> phaseList;
+				string word;
+				fin >> word;
+				while(word != "End") {
+					if (fin.fail()) {
+						std::cerr << "Error reading Phases.\n";
+						exit(-1);
+					}
+					if (word == "Phase") {
+						PhaseDef phase;
+						getline(fin, phase.name);
+						if (phase.name.size() >= 1) phase.name = phase.name.substr(1);
+						if (phase.name.size() == 0) {
+							std::ostringstream number;
+							number << phaseList.size() + 1;
+							phase.name = number.str();
+						}
+						phaseList.push_back(phase);
+					}
+					else if (phaseList.empty()) {
+						std::cerr << "Phases must start with a Phase command.\n";
+						exit(-1);
+					}
+					else if (word == "Ignore") {
+						phaseList.back().ignore = readIgnore(fin, datasets, "Ignore of phase " + phaseList.back().name);
+					}
+					else if (word == "Moves") {
+						// a name ending in * stands for the move and all its powers
+						string movename;
+						fin >> movename;
+						while(movename != "End") {
+							if (fin.fail() || movename.size() < 1) {
+								std::cerr << "Error reading the Moves of phase " << phaseList.back().name << ".\n";
+								exit(-1);
+							}
+							bool group = (movename.at(movename.size()-1) == '*');
+							if (group)
+								movename = movename.substr(0, movename.size()-1);
+							if (!moveIn(movename, moves)) {
+								std::cerr << "Move " << movename << " used in phase " << phaseList.back().name << " is not previously declared.\n";
+								exit(-1);
+							}
+							int id = getMoveID(movename, moves);
+							MoveList::iterator moveIter;
+							for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++)
+								if (moveIter->first == id || (group && moveIter->second.parentID == id))
+									phaseList.back().moves.push_back(moveIter->first);
+							fin >> movename;
+						}
+					}
+					else {
+						std::cerr << "Unknown command \"" << word << "\" in Phases.\n";
+						exit(-1);
+					}
+					fin >> word;
+				}
+				if (phaseList.empty())
+					current_phases = -1;
+				else {
+					current_phases = phases.size();
+					phases.push_back(phaseList);
+				}
+			}
+			// MoveCost - what moves cost, instead of what QTM or HTM says
+			else if (command == "MoveCost"){
+				moveCosts.clear();
+				string movename;
+				int cost;
+				fin >> movename;
+				while(movename != "End") {
+					if (fin.fail() || movename.size() < 1) {
+						std::cerr << "Error reading move costs.\n";
+						exit(-1);
+					}
+					bool group = (movename.at(movename.size()-1) == '*');
+					if (group)
+						movename = movename.substr(0, movename.size()-1);
+					if (!moveIn(movename, moves)) {
+						std::cerr << "Move " << movename << " used in move costs is not previously declared.\n";
+						exit(-1);
+					}
+					fin >> cost;
+					if (fin.fail() || cost < 1 || cost > MAX_MOVE_COST){
+						std::cerr << "Move costs must be from 1 to " << MAX_MOVE_COST << ".\n";
+						exit(-1);
+					}
+					int id = getMoveID(movename, moves);
+					MoveList::iterator moveIter;
+					for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++)
+						if (moveIter->first == id || (group && moveIter->second.parentID == id))
+							moveCosts[moveIter->first] = cost;
+					fin >> movename;
+				}
+			}
 			// Move Limits
 			else if (command == "MoveLimits"){
 				moveLimits.clear();
@@ -428,10 +587,94 @@ public:
 		ScrambleDef tmp;
 		return tmp;
 	}
+
+	// Each Phases command, in the order of the file
+	std::vector<std::vector<PhaseDef> > getPhases(){
+		return phases;
+	}
+
+	// The cost of each move (by MoveList ID) in each metric the scrambles use.
+	// Metric 0 is HTM, whether any scramble uses it or not.
+	std::vector<std::map<int, int> > getMetrics(){
+		return metrics;
+	}
 	
 private:
+	// The metric with what the moves cost now: the MoveCost command, and QTM
+	// (metric 1) or HTM (metric 0) for the moves it doesn't give
+	int metricIndex(int metric, MoveList& moves){
+		std::map<int, int> costs;
+		MoveList::iterator moveIter;
+		for (moveIter = moves.begin(); moveIter != moves.end(); moveIter++){
+			std::map<int, int>::iterator found = moveCosts.find(moveIter->first);
+			if (found != moveCosts.end())
+				costs[moveIter->first] = found->second;
+			else
+				costs[moveIter->first] = (metric == 1) ? moveIter->second.qtm : 1;
+		}
+		for (unsigned int k = 0; k < metrics.size(); k++)
+			if (metrics[k] == costs)
+				return k;
+		metrics.push_back(costs);
+		return metrics.size() - 1;
+	}
+
+	// Read what a phase ignores: for each set, 1 for each piece whose
+	// permutation doesn't matter (0 otherwise), then optionally the same for
+	// the orientations. Sets that aren't given are not ignored.
+	Position readIgnore(std::istream& fin, PieceTypes& datasets, string title){
+		Position ignore;
+		string setname, tmpStr;
+		fin >> setname;
+		while(setname != "End"){
+			if (fin.fail()){
+				std::cerr << "Error reading " << title << ".\n";
+				exit(-1);
+			}
+			if (datasets.find(setname) == datasets.end()){
+				std::cerr << "Unknown set " << setname << " in " << title << ".\n";
+				exit(-1);
+			}
+			if (ignore.find(setname) != ignore.end()){
+				std::cerr << "Set " << setname << " declared more than once in " << title << ".\n";
+				exit(-1);
+			}
+			int size = datasets[setname].size;
+			ignore[setname] = newSubstate(size);
+			for (int i = 0; i < size; i++){
+				fin >> ignore[setname].permutation[i];
+				ignore[setname].orientation[i] = 0;
+				if (fin.fail()){
+					std::cerr << "Error reading " << setname << " permutation in " << title << ".\n";
+					exit(-1);
+				}
+			}
+
+			// read something in. if it doesn't look like a number,
+			// use it as the setname. otherwise, read in orientation
+			fin >> tmpStr;
+			if (tmpStr.size() == 0 || tmpStr.at(0) < '0' || tmpStr.at(0) > '9') {
+				setname = tmpStr;
+				continue;
+			}
+			ignore[setname].orientation[0] = atoi(tmpStr.c_str());
+			for (int i = 1; i < size; i++){
+				fin >> ignore[setname].orientation[i];
+				if (fin.fail()){
+					std::cerr << "Error reading " << setname << " orientation in " << title << ".\n";
+					exit(-1);
+				}
+			}
+			fin >> setname;
+		}
+		return ignore;
+	}
+
+	std::vector<std::vector<PhaseDef> > phases;
 	std::vector<ScrambleDef> states;
 	std::vector<MoveLimit> moveLimits;
+	std::map<int, int> moveCosts; // set by MoveCost, by MoveList ID
+	std::vector<std::map<int, int> > metrics;
 	unsigned int sent;
 };
 
@@ -22,214 +22,479 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
-static bool treeSolve(Position state, Position& solved, MoveList& moves, PieceTypes& datasets, PruneTable& prunetables, std::set<MovePair>& forbiddenPairs, Position& ignore, std::vector<Block>& blocks, int depth, int metric, std::vector<MoveLimit>& moveLimits, string sequence, int old_move, bool splitThreads){
+// state and coords point into buffers with room for one more state (and set of
+// coordinates) per remaining move, and so does inverse, the inverse position,
+// if context.inverseSets is used (NULL otherwise). The inverse is only worked
+// out when it is needed: if inverseMove is not -1, inverse still has to be
+// computed from the one before it for that move. The moves made so far are the
+// first length entries of context.sequence. hash is only used with a
+// transposition table. Every node that is cut off for lack of depth lowers
+// context.excess to what it would have needed (see noteExcess).
+static bool treeSolve(unsigned char* state, unsigned char* inverse, int inverseMove, int* coords, SearchContext& context, int depth, LimitCounts& limits, int length, int moveState, unsigned long long hash){
+	if (context.control->cancelled)
+		return false;
+	context.nodes++;
+	if (context.nodes % BUDGET_CHECK_NODES == 0)
+		checkBudget(*context.control, BUDGET_CHECK_NODES);
+
 	// if we ran out of depth, it's either solved or not
 	if (depth <= 0) {
-		if (isSolved(state, solved, ignore, datasets)){
-            #pragma omp critical
-            {
-                std::cout << sequence << "\n";
-            }
+		if (isSolved(state, *context.masks, context.puzzle->stateSize)){
+			reportSolution(context, context.sequence, length);
+			if (context.alternatives != NULL) {
+				std::vector<int> other(context.sequence, context.sequence + length + 1);
+				int prefix = context.prefixLength;
+				for (unsigned int a = 0; a < context.alternatives->size(); a += prefix) {
+					std::copy(context.alternatives->begin() + a, context.alternatives->begin() + a + prefix, other.begin());
+					reportSolution(context, &other[0], length);
+				}
+			}
+			// with Slack, longer sequences through here can be solutions too
+			noteExcess(context, context.minCost);
 			return true;
 		} else {
+			noteExcess(context, context.minCost);
 			return false;
 		}
 	}
 
 	// use pruning tables to see if we don't have enough depth left
-	if (prune(state, depth, datasets, prunetables))
+	int excess = context.excess;
+	int pruned = pruningTable(state, coords, depth, *context.puzzle, *context.pruneOrder, (context.stats != NULL) ? &context.stats->checked[0] : NULL, &excess);
+	if (pruned >= 0) {
+		if (context.stats != NULL)
+			context.stats->pruned[pruned]++;
+		noteExcess(context, excess);
 		return false;
+	}
+	if (inverse != NULL) {
+		if (inverseMove != -1)
+			applyInverseMove(inverse - context.puzzle->stateSize, inverse, context.puzzle->moves[inverseMove], *context.puzzle, *context.inverseSets);
+		if (inverseCuts(inverse, depth, *context.puzzle, *context.inverseSets, (context.stats != NULL) ? &context.stats->inverseChecked : NULL, &excess)) {
+			if (context.stats != NULL)
+				context.stats->inversePruned++;
+			noteExcess(context, excess);
+			return false;
+		}
+	}
+
+	// have we been here before, and found nothing? (move limits make positions
+	// depend on the moves used to get there, so they can't be stored)
+	bool useTable = (context.table != NULL && depth >= MIN_TABLE_DEPTH && context.limits->count == 0);
+	if (useTable) {
+		if (tableLookup(*context.table, hash, moveState, depth)) {
+			context.tableHits++;
+			noteExcess(context, 1); // only known to need more than depth
+			return false;
+		}
+		context.tableMisses++;
+	}
 
-	// define variables; initialize room for a new state
 	bool success = false;
-	bool using_blocks = (blocks.size() != 0);
-	bool using_limits = (moveLimits.size() != 0);
-
-    if(splitThreads) {
-        #pragma omp parallel //num_threads(1)
-        {
-        //for (iter = moves.begin(); iter != moves.end(); iter++){
-            Position new_state;
-            Position::iterator iter2;
-            for (iter2 = state.begin(); iter2 != state.end(); iter2++){
-                new_state[iter2->first] = newSubstate(iter2->second.size);
-            }
-
-            std::vector<MoveLimit> localMoveLimits = moveLimits;
-
-            #pragma omp for
-            for (int i = 0; i < moves.size(); i++){
-                MoveList::iterator iter = moves.begin();
-                for(int j = 0; j < i; j++)
-                    iter++;
-                // if we have a forbidden pair, try the next move
-                if (forbiddenPairs.find(MovePair(old_move, iter->first)) != forbiddenPairs.end())
-                    continue;
-                // if this move breaks the blocks, try the next move
-                if (using_blocks)
-                    if (!blockLegal(state, blocks, iter->second.state))
-                        continue;
-                // if movelimits make this move impossible, try the next move
-                if (using_limits) {
-                    bool forbidden = false;
-                    for (unsigned int i=0; i<localMoveLimits.size(); i++) {
-                        if (localMoveLimits[i].limit <= 0 && limitMatches(localMoveLimits[i], iter->second)) {
-                            forbidden = true;
-                            break;
-                        }
-                    }
-                    if (forbidden) continue;
-                }
-
-                // compute depth of new position using HTM or QTM
-                int newDepth;
-                if (metric == 0) { // HTM
-                    newDepth = depth - 1;
-                } else { // QTM
-                    newDepth = depth - iter->second.qtm;
-                }
-                if (newDepth < 0) continue; // not enough depth for this move? try the next one
-
-                // compute new position
-                applyMove(state, new_state, iter->second.state, datasets);
-
-                // decrement applicable move limits, and check if we got into an unsolvable state
-                if (using_limits) {
-                    bool isSolvable = true; // see if we have stumbled into a situation that requires more of the limited moves
-                    for (unsigned int i=0; i<localMoveLimits.size(); i++) {
-                        if (limitMatches(localMoveLimits[i], iter->second)) {
-                            localMoveLimits[i].limit--;
-                            if (localMoveLimits[i].limit == 0) {
-                                isSolvable = isSolvable && stillSolvable(new_state, solved, ignore, localMoveLimits[i].owned);
-                            }
-                        }
-                    }
-                    if (!isSolvable) {
-                        for (unsigned int i=0; i<moveLimits.size(); i++)
-                            if (limitMatches(localMoveLimits[i], iter->second))
-                                localMoveLimits[i].limit++;
-                        continue;
-                    }
-                }
-
-                // recurse!
-                if (treeSolve(new_state, solved, moves, datasets, prunetables, forbiddenPairs, ignore, blocks, newDepth, metric, localMoveLimits, sequence + " " + iter->second.name, iter->first, false))
-                    success = true;
-
-                // clean up modified move limits
-                if (using_limits)
-                    for (unsigned int i=0; i<localMoveLimits.size(); i++)
-                        if (limitMatches(localMoveLimits[i], iter->second))
-                            localMoveLimits[i].limit++;
-            }
-            // free new_state memory
-            for (iter2 = state.begin(); iter2 != state.end(); iter2++){
-                delete new_state[iter2->first].permutation;
-                delete new_state[iter2->first].orientation;
-            }
-        }
+	unsigned char* new_state = state + context.puzzle->stateSize;
+	unsigned char* new_inverse = (inverse != NULL) ? inverse + context.puzzle->stateSize : NULL;
+	int* new_coords = coords + context.puzzle->coords.size();
+	int nMoves = context.puzzle->moves.size();
+	for (int i = 0; i < nMoves; i++){
+		int newDepth = tryMove(state, coords, new_state, new_coords, context, depth, limits, moveState, i);
+		if (newDepth < 0) continue;
+
+		// recurse!
+		unsigned long long newHash = (context.table != NULL) ? updateHash(hash, state, new_state, *context.table, i) : 0;
+		context.sequence[length] = i;
+		if (treeSolve(new_state, new_inverse, i, new_coords, context, newDepth, limits, length + 1, context.puzzle->automaton[moveState * nMoves + i], newHash))
+			success = true;
+
+		releaseMove(limits, *context.limits, i);
 	}
-    else {
-        Position new_state;
-        Position::iterator iter2;
-        for (iter2 = state.begin(); iter2 != state.end(); iter2++){
-            new_state[iter2->first] = newSubstate(iter2->second.size);
-        }
-        MoveList::iterator iter = moves.begin();
-        for (iter = moves.begin(); iter != moves.end(); iter++){
-            // if we have a forbidden pair, try the next move
-            if (forbiddenPairs.find(MovePair(old_move, iter->first)) != forbiddenPairs.end())
-                continue;
-            // if this move breaks the blocks, try the next move
-            if (using_blocks)
-                if (!blockLegal(state, blocks, iter->second.state))
-                    continue;
-            // if movelimits make this move impossible, try the next move
-            if (using_limits) {
-                bool forbidden = false;
-                for (unsigned int i=0; i<moveLimits.size(); i++) {
-                    if (moveLimits[i].limit <= 0 && limitMatches(moveLimits[i], iter->second)) {
-                        forbidden = true;
-                        break;
-                    }
-                }
-                if (forbidden) continue;
-            }
-            // compute depth of new position using HTM or QTM
-            int newDepth;
-            if (metric == 0) { // HTM
-                newDepth = depth - 1;
-            } else { // QTM
-                newDepth = depth - iter->second.qtm;
-            }
-            if (newDepth < 0) continue; // not enough depth for this move? try the next one
-
-            // compute new position
-            applyMove(state, new_state, iter->second.state, datasets);
-
-            // decrement applicable move limits, and check if we got into an unsolvable state
-            if (using_limits) {
-                bool isSolvable = true; // see if we have stumbled into a situation that requires more of the limited moves
-                for (unsigned int i=0; i<moveLimits.size(); i++) {
-                    if (limitMatches(moveLimits[i], iter->second)) {
-                        moveLimits[i].limit--;
-                        if (moveLimits[i].limit == 0) {
-                            isSolvable = isSolvable && stillSolvable(new_state, solved, ignore, moveLimits[i].owned);
-                        }
-                    }
-                }
-                if (!isSolvable) {
-                    for (unsigned int i=0; i<moveLimits.size(); i++)
-                        if (limitMatches(moveLimits[i], iter->second))
-                            moveLimits[i].limit++;
-                    continue;
-                }
-            }
-
-            // recurse!
-            if (treeSolve(new_state, solved, moves, datasets, prunetables, forbiddenPairs, ignore, blocks, newDepth, metric, moveLimits, sequence + " " + iter->second.name, iter->first, false))
-                success = true;
-
-            // clean up modified move limits
-            if (using_limits)
-                for (unsigned int i=0; i<moveLimits.size(); i++)
-                    if (limitMatches(moveLimits[i], iter->second))
-                        moveLimits[i].limit++;
-        }
-        // free new_state memory
-        for (iter2 = state.begin(); iter2 != state.end(); iter2++){
-            delete new_state[iter2->first].permutation;
-            delete new_state[iter2->first].orientation;
-        }
-    }
+	// a cancelled search may have skipped solutions, so it proves nothing
+	if (useTable && !success && !context.control->cancelled)
+		tableStore(*context.table, hash, moveState, depth);
 	return success;
 }
 
-// does this position count as solved?
-static bool isSolved(Position& state1, Position& state2, Position& ignore, PieceTypes& datasets){
-	if (ignore.size() == 0){
-		 return isEqual(state1, state2, datasets);
+// Hand a solution to the sink, and its images under context.images
+static void reportSolution(SearchContext& context, int* sequence, int length){
+	if (claimSolution(*context.control)) {
+		context.sink->found(context.thread, sequence, length);
+		if (context.stats != NULL)
+			context.stats->solutions++;
+	}
+	if (context.images != NULL && !context.images->empty()) {
+		std::vector<int> image(length + 1);
+		for (unsigned int g = 0; g < context.images->size(); g++) {
+			applySymmetry(sequence, &image[0], length, context.puzzle->symmetries[(*context.images)[g]]);
+			if (claimSolution(*context.control)) {
+				context.sink->found(context.thread, &image[0], length);
+				if (context.stats != NULL)
+					context.stats->solutions++;
+			}
+		}
+	}
+}
+
+// Try move i from a position. If the move is allowed here, new_state and new_coords
+// get the new position, the move limits are used up (give them back with releaseMove)
+// and the depth left after the move is returned. Otherwise returns -1.
+static int tryMove(unsigned char* state, int* coords, unsigned char* new_state, int* new_coords, SearchContext& context, int depth, LimitCounts& limits, int moveState, int i){
+	CompiledPuzzle& puzzle = *context.puzzle;
+	compiledmove& move = puzzle.moves[i];
+	int nMoves = puzzle.moves.size();
+
+	// if the sequence so far makes this move redundant, try the next move
+	if (puzzle.automaton[moveState * nMoves + i] < 0) {
+		if (context.stats != NULL)
+			context.stats->forbidden++;
+		return -1;
+	}
+	// if this move breaks the blocks, try the next move
+	if (puzzle.blocks.size() != 0)
+		if (!blockLegal(state, puzzle, move)) {
+			if (context.stats != NULL)
+				context.stats->blocked++;
+			return -1;
+		}
+	// if movelimits make this move impossible, try the next move
+	unsigned int limited = context.limits->moves[i];
+	if (limited != 0)
+		for (int l = 0; l < context.limits->count; l++)
+			if ((limited >> l & 1) && limits.left[l] <= 0) {
+				if (context.stats != NULL)
+					context.stats->limited++;
+				return -1;
+			}
+
+	// compute depth of new position using the move's cost in the metric
+	int newDepth = depth - move.cost[context.metric];
+	if (newDepth < 0) { // not enough depth for this move? try the next one
+		noteExcess(context, -newDepth);
+		return -1;
 	}
-	else{
-		Position::iterator iter;
-		for (iter = state1.begin(); iter != state1.end(); iter++){
-			if (ignore.find(iter->first) != ignore.end()){
-				for (int i = 0; i < state1[iter->first].size; i++){
-					if (ignore[iter->first].permutation[i] == 0 && state1[iter->first].permutation[i] != state2[iter->first].permutation[i])
-						return false;
+
+	// compute new position
+	applyMove(state, new_state, move, puzzle);
+	for (unsigned int c = 0; c < puzzle.coords.size(); c++)
+		new_coords[c] = (*puzzle.coords[c].moves)[coords[c] * nMoves + i];
+
+	// decrement applicable move limits, and check if we got into an unsolvable state
+	if (limited != 0) {
+		bool isSolvable = true; // see if we have stumbled into a situation that requires more of the limited moves
+		for (int l = 0; l < context.limits->count; l++) {
+			if (limited >> l & 1) {
+				limits.left[l]--;
+				if (limits.left[l] == 0) {
+					isSolvable = isSolvable && stillSolvable(new_state, puzzle, context.limits->owned[l]);
 				}
-				if (datasets[iter->first].omod != 1)
-					for (int i = 0; i < state1[iter->first].size; i++)
-						if (ignore[iter->first].orientation[i] == 0 && state1[iter->first].orientation[i] != state2[iter->first].orientation[i])
-							return false;
-			} else {
-				if (memcmp(iter->second.permutation, state2[iter->first].permutation, iter->second.size*sizeof(int)) != 0)
-					return false;
-				if (datasets[iter->first].omod != 1)
-					if (memcmp(iter->second.orientation, state2[iter->first].orientation, iter->second.size*sizeof(int)) != 0)
-						return false;
 			}
 		}
+		if (!isSolvable) {
+			releaseMove(limits, *context.limits, i);
+			if (context.stats != NULL)
+				context.stats->limited++;
+			return -1;
+		}
+	}
+	return newDepth;
+}
+
+// May we hand out one more solution? Cancels the search when this uses up the
+// last one.
+static bool claimSolution(SearchControl& control){
+	if (control.maxSolutions <= 0)
+		return true;
+	bool claimed = false;
+	#pragma omp critical (claimSolution)
+	{
+		if (control.solutions < control.maxSolutions) {
+			control.solutions++;
+			claimed = true;
+		}
+		if (control.solutions >= control.maxSolutions)
+			control.cancelled = true;
+	}
+	return claimed;
+}
+
+// Count nodes visited against the node limit, and check the clock. Cancels
+// the search when either limit is used up.
+static void checkBudget(SearchControl& control, long long nodes){
+	if (control.nodeLimit <= 0 && control.timeLimit <= 0)
+		return;
+	#pragma omp atomic
+	control.nodes += nodes;
+	if (control.nodeLimit > 0 && control.nodes >= control.nodeLimit) {
+		control.outOfNodes = true;
+		control.cancelled = true;
+	}
+	if (control.timeLimit > 0 && wallTime() - control.startTime >= control.timeLimit) {
+		control.outOfTime = true;
+		control.cancelled = true;
+	}
+}
+
+// Say which limit stopped the search at this depth, what it had proved by then,
+// and the depth of the first solution found, if there was one (solutionDepth,
+// or -1). A solution at the depth that was cut short is optimal, as all the
+// depths before it were searched.
+static void reportBudget(SearchControl& control, int depth, int solutionDepth, std::ostream& out){
+	out << "\n" << (control.outOfNodes ? "Node" : "Time") << " limit reached, stopping.\n";
+	if (depth > 0)
+		out << "Depths up to " << depth - 1 << " were searched completely.\n";
+	else
+		out << "No depth was searched completely.\n";
+	if (solutionDepth < 0 || solutionDepth == depth)
+		out << "Lower bound: " << depth << "\n";
+	if (solutionDepth >= 0)
+		out << "Best found: " << solutionDepth << "\n";
+}
+
+// A node was cut off, and would have needed excess more depth left. The least
+// of these over an iteration is how much deeper the next one has to go to see
+// anything new.
+static inline void noteExcess(SearchContext& context, int excess){
+	if (excess < context.excess)
+		context.excess = excess;
+}
+
+// Seconds since some fixed time in the past, by the wall clock
+static double wallTime(){
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+// Give back the move limits used up by tryMove
+static void releaseMove(LimitCounts& limits, CompiledLimits& compiled, int move){
+	unsigned int limited = compiled.moves[move];
+	if (limited != 0)
+		for (int l = 0; l < compiled.count; l++)
+			if (limited >> l & 1)
+				limits.left[l]++;
+}
+
+// Number of threads the search will use
+static int searchThreads(){
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+// Search a position to the given depth with all threads. The top of the tree is
+// split into subtrees, options.splitDepth levels deep or (adaptively) until there
+// are enough to keep every thread busy, and each thread takes the next subtree
+// from the list as soon as it finishes the last one. threadNodes gets the nodes
+// visited by each thread; nodes visited while splitting go to context.nodes.
+// inverse is the inverse position, or NULL (see treeSolve). context.excess gets
+// how much deeper the next iteration has to go, or NO_EXCESS if no node was cut
+// off for lack of depth, so that no deeper search can find anything new.
+// With a frontier cache, the search starts from its nodes instead of the
+// scramble, and the cache is built on the first call.
+static bool parallelSolve(unsigned char* state, unsigned char* inverse, int* coords, SearchContext& context, int depth, LimitCounts& limits, Options& options, std::vector<long long>& threadNodes, FrontierCache* cache){
+	CompiledPuzzle& puzzle = *context.puzzle;
+	int stateSize = puzzle.stateSize;
+	int nCoords = puzzle.coords.size();
+	int nMoves = puzzle.moves.size();
+	int threads = threadNodes.size();
+	context.excess = NO_EXCESS;
+
+	unsigned int target = (threads > 1) ? threads * SPLIT_NODES_PER_THREAD : 1;
+	int levels = depth;
+	if (options.splitDepth >= 0) {
+		target = MAX_SPLIT_NODES;
+		levels = std::min(depth, options.splitDepth);
+	}
+
+	// symmetries that keep the scramble (and what it ignores) as it is. Only the
+	// first moves that are smallest among their images need to be searched; the
+	// solutions starting with the other moves are printed as images of those.
+	std::vector<int> fixing;
+	if (puzzle.blocks.empty() && context.limits->count == 0 && (depth > 0 || cache != NULL)) {
+		std::vector<unsigned char> image(stateSize);
+		std::vector<unsigned char>& mask = *context.ignore;
+		for (unsigned int g = 1; g < puzzle.symmetries.size(); g++) {
+			compiledsymmetry& symmetry = puzzle.symmetries[g];
+			if (!symmetry.keepsOrder)
+				continue;
+			applySymmetry(state, &image[0], symmetry, puzzle);
+			bool fixed = (memcmp(&image[0], state, stateSize) == 0);
+			for (int i = 0; i < stateSize && fixed && !mask.empty(); i++)
+				if (mask[symmetry.slot[i]] != mask[i])
+					fixed = false;
+			if (fixed)
+				fixing.push_back(g);
+		}
+	}
+
+	std::vector<SearchNode> frontier;
+	if (cache != NULL && !cache->built)
+		buildFrontier(*cache, state, coords, context, limits, fixing);
+	if (cache != NULL && !cache->tooLarge) {
+		cachedFrontier(*cache, context, depth, frontier);
+		fixing.clear(); // the cache only has the smallest first moves already
+		context.prefixLength = cache->level;
+	} else {
+		frontier.resize(1);
+		frontier[0].state.assign(state, state + stateSize);
+		if (inverse != NULL)
+			frontier[0].inverse.assign(inverse, inverse + stateSize);
+		frontier[0].coords.assign(coords, coords + nCoords + 1);
+		frontier[0].limits = limits;
+		frontier[0].moveState = context.startState;
+		frontier[0].depth = depth;
+	}
+
+	// expand the tree one level at a time, in move order, so that a single thread
+	// still visits the nodes (and prints the solutions) in the usual order
+	for (int level = 0; level < levels && (frontier.size() < target || (level == 0 && !fixing.empty())); level++) {
+		std::vector<SearchNode> next;
+		bool expanded = false;
+		for (unsigned int n = 0; n < frontier.size(); n++) {
+			SearchNode& node = frontier[n];
+			// leaves are checked by treeSolve
+			if (node.depth <= 0 || next.size() + nMoves > MAX_SPLIT_NODES) {
+				next.push_back(node);
+				continue;
+			}
+			expanded = true;
+			context.nodes++;
+			int excess = context.excess;
+			int pruned = pruningTable(&node.state[0], &node.coords[0], node.depth, puzzle, *context.pruneOrder, (context.stats != NULL) ? &context.stats->checked[0] : NULL, &excess);
+			if (pruned >= 0) {
+				if (context.stats != NULL)
+					context.stats->pruned[pruned]++;
+				noteExcess(context, excess);
+				continue;
+			}
+			if (inverse != NULL && inverseCuts(&node.inverse[0], node.depth, puzzle, *context.inverseSets, (context.stats != NULL) ? &context.stats->inverseChecked : NULL, &excess)) {
+				if (context.stats != NULL)
+					context.stats->inversePruned++;
+				noteExcess(context, excess);
+				continue;
+			}
+			SearchNode child;
+			child.state.resize(stateSize);
+			if (inverse != NULL)
+				child.inverse.resize(stateSize);
+			child.coords.resize(nCoords + 1);
+			for (int i = 0; i < nMoves; i++) {
+				if (level == 0 && !fixing.empty()) {
+					if (!smallestFirstMove(puzzle, fixing, i, child.images)) continue;
+				} else
+					child.images = node.images;
+				child.alternatives = node.alternatives;
+				child.depth = tryMove(&node.state[0], &node.coords[0], &child.state[0], &child.coords[0], context, node.depth, node.limits, node.moveState, i);
+				if (child.depth < 0) continue;
+				if (inverse != NULL)
+					applyInverseMove(&node.inverse[0], &child.inverse[0], puzzle.moves[i], puzzle, *context.inverseSets);
+				child.limits = node.limits;
+				child.sequence = node.sequence;
+				child.sequence.push_back(i);
+				child.moveState = puzzle.automaton[node.moveState * nMoves + i];
+				next.push_back(child);
+				releaseMove(node.limits, *context.limits, i);
+			}
+		}
+		frontier.swap(next);
+		if (!expanded) break;
+	}
+
+	// search the subtrees, handing them out to threads as they become free
+	int count = frontier.size();
+	bool success = false;
+	#pragma omp parallel num_threads(threads)
+	{
+		SearchContext local = context;
+		local.nodes = 0;
+		local.tableHits = 0;
+		local.tableMisses = 0;
+		SearchStats stats;
+		if (context.stats != NULL) {
+			clearStats(stats, puzzle);
+			local.stats = &stats;
+		}
+#ifdef _OPENMP
+		local.thread = omp_get_thread_num();
+#else
+		local.thread = 0;
+#endif
+		std::vector<int> sequence(depth + 1);
+		local.sequence = &sequence[0];
+		std::vector<unsigned char> buffer((depth + 2) * stateSize);
+		std::vector<unsigned char> inverseBuffer((inverse != NULL) ? (depth + 2) * stateSize : 0);
+		std::vector<int> coordBuffer((depth + 2) * nCoords + 1);
+
+		#pragma omp for schedule(dynamic, 1) reduction(||:success)
+		for (int n = 0; n < count; n++) {
+			SearchNode& node = frontier[n];
+			memcpy(&buffer[0], &node.state[0], stateSize);
+			if (inverse != NULL)
+				memcpy(&inverseBuffer[0], &node.inverse[0], stateSize);
+			memcpy(&coordBuffer[0], &node.coords[0], nCoords * sizeof(int));
+			local.images = &node.images;
+			local.alternatives = node.alternatives.empty() ? NULL : &node.alternatives;
+			unsigned long long hash = (local.table != NULL) ? hashState(&buffer[0], *local.table, stateSize) : 0;
+			std::copy(node.sequence.begin(), node.sequence.end(), sequence.begin());
+			if (treeSolve(&buffer[0], (inverse != NULL) ? &inverseBuffer[0] : NULL, -1, &coordBuffer[0], local, node.depth, node.limits, node.sequence.size(), node.moveState, hash))
+				success = true;
+		}
+
+		local.sink->flush(local.thread);
+		threadNodes[local.thread] += local.nodes;
+		#pragma omp atomic
+		context.tableHits += local.tableHits;
+		#pragma omp atomic
+		context.tableMisses += local.tableMisses;
+		#pragma omp critical (noteExcess)
+		noteExcess(context, local.excess);
+		if (context.stats != NULL) {
+			#pragma omp critical (addStats)
+			addStats(*context.stats, stats);
+		}
+	}
+	return success;
+}
+
+// Is move i the smallest of its images under the symmetries that keep the
+// scramble (see parallelSolve)? If so, images gets the symmetries that take it
+// to each of the other ones.
+static bool smallestFirstMove(CompiledPuzzle& puzzle, std::vector<int>& fixing, int i, std::vector<int>& images){
+	images.clear();
+	std::set<int> seen;
+	for (unsigned int g = 0; g < fixing.size(); g++) {
+		int j = puzzle.symmetries[fixing[g]].move[i];
+		if (j < i)
+			return false;
+		if (j != i && seen.insert(j).second)
+			images.push_back(fixing[g]);
+	}
+	return true;
+}
+
+// Nodes visited so far, while splitting the tree and by the search threads
+static long long totalNodes(SearchContext& context, std::vector<long long>& threadNodes){
+	long long nodes = context.nodes;
+	for (unsigned int t = 0; t < threadNodes.size(); t++)
+		nodes += threadNodes[t];
+	return nodes;
+}
+
+// does this position count as solved? (compared 8 bytes at a time, leaving out
+// the bytes the scramble ignores)
+static bool isSolved(const unsigned char* state, IgnoreMasks& masks, int size){
+	int words = size / 8;
+	for (int w = 0; w < words; w++) {
+		unsigned long long bytes;
+		memcpy(&bytes, state + 8 * w, 8);
+		if ((bytes & masks.mask[w]) != masks.solved[w])
+			return false;
+	}
+	if (size % 8 != 0) {
+		unsigned long long bytes = 0;
+		memcpy(&bytes, state + 8 * words, size % 8);
+		if ((bytes & masks.mask[words]) != masks.solved[words])
+			return false;
 	}
 	return true;
 }
@@ -247,20 +512,12 @@ static bool isEqual(Position& state1, Position& state2, PieceTypes& datasets){
 	return true;
 }
 
-// is this position still solvable? i.e. any unsolved, unignored pieces in the block?
-static bool stillSolvable(Position& state, Position& solved, Position& ignore, Block& owned){
-	Block::iterator iter;
-	for (iter = owned.begin(); iter != owned.end(); iter++) {
-		std::set<int>::iterator iter2;
-		string type = iter->first;
-		for (iter2 = owned[type].begin(); iter2 != owned[type].end(); iter2++) {
-			// if not solved and not ignored, return false!
-			if ((ignore[type].permutation[*iter2] == 0 && state[type].permutation[*iter2] != solved[type].permutation[*iter2]) ||
-				(ignore[type].orientation[*iter2] == 0 && solved[type].orientation[*iter2] != solved[type].orientation[*iter2])) {
-				return false;
-			}
-		}
-	}
+// is this position still solvable? i.e. are all the (unignored) bytes of a used
+// up limit's owned pieces solved?
+static bool stillSolvable(unsigned char* state, CompiledPuzzle& puzzle, std::vector<int>& owned){
+	for (unsigned int i = 0; i < owned.size(); i++)
+		if (state[owned[i]] != puzzle.solved[owned[i]])
+			return false;
 	return true;
 }
 
@@ -0,0 +1,131 @@
+/*
+ KSolve+ - Puzzle solving program.
+ Copyright (C) 2007-2013 Kre Krig and Michael Gottlieb
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Receivers for the solutions found by the search
+
+#ifndef SINK_H
+#define SINK_H
+
+// Base class for anything that wants the solutions. found() is called by the
+// search threads at the same time, each with its own thread number, so a sink
+// only needs to lock if it shares something between threads. flush() is called
+// by each thread at the end of a depth, and the other functions by the main
+// thread only.
+class SolutionSink {
+public:
+	virtual ~SolutionSink() {}
+	virtual void startScramble(CompiledPuzzle& puzzle, string name) {}
+	virtual void found(int thread, const int* moves, int length) = 0;
+	virtual void flush(int thread) {}
+	virtual void endScramble() {}
+};
+
+// Writes the solutions to a stream. Each thread collects its solutions in its
+// own buffer, which is written out (under a lock) when it gets big or at the end
+// of a depth.
+class StreamSink : public SolutionSink {
+public:
+	StreamSink(int threads, bool json, std::ostream& out = std::cout) : buffers(threads), json(json), puzzle(NULL), out(out) {}
+
+	virtual void startScramble(CompiledPuzzle& newPuzzle, string name) {
+		puzzle = &newPuzzle;
+		scramble = jsonString(name);
+	}
+
+	virtual void found(int thread, const int* moves, int length) {
+		string& buffer = buffers[thread];
+		if (json) {
+			buffer += "{\"scramble\": " + scramble + ", \"moves\": [";
+			for (int m = 0; m < length; m++) {
+				if (m > 0) buffer += ", ";
+				buffer += jsonString(puzzle->moves[moves[m]].name);
+			}
+			buffer += "]}\n";
+		} else {
+			buffer += " ";
+			for (int m = 0; m < length; m++)
+				buffer += " " + puzzle->moves[moves[m]].name;
+			buffer += "\n";
+		}
+		if (buffer.size() >= SINK_BUFFER_SIZE)
+			flush(thread);
+	}
+
+	virtual void flush(int thread) {
+		if (buffers[thread].empty())
+			return;
+		#pragma omp critical
+		{
+			out << buffers[thread];
+			out.flush();
+		}
+		buffers[thread].clear();
+	}
+
+private:
+	static string jsonString(string text) {
+		string quoted = "\"";
+		for (unsigned int i = 0; i < text.size(); i++) {
+			if (text[i] == '"' || text[i] == '\\')
+				quoted += '\\';
+			quoted += text[i];
+		}
+		return quoted + "\"";
+	}
+
+	std::vector<string> buffers;
+	bool json;
+	CompiledPuzzle* puzzle;
+	string scramble;
+	std::ostream& out;
+};
+
+// Only counts the solutions, and prints the count after each scramble
+class CountSink : public SolutionSink {
+public:
+	CountSink(int threads, std::ostream& out = std::cout) : counts(threads, 0), out(out) {}
+
+	virtual void startScramble(CompiledPuzzle& puzzle, string name) {
+		std::fill(counts.begin(), counts.end(), 0);
+	}
+
+	virtual void found(int thread, const int* moves, int length) {
+		counts[thread]++;
+	}
+
+	virtual void endScramble() {
+		long long total = 0;
+		for (unsigned int t = 0; t < counts.size(); t++)
+			total += counts[t];
+		out << "Solutions: " << total << "\n";
+	}
+
+private:
+	std::vector<long long> counts;
+	std::ostream& out;
+};
+
+// The sink the --output option asks for, writing to out
+static SolutionSink* newSink(Options& options, int threads, std::ostream& out){
+	if (options.output == OUTPUT_COUNT)
+		return new CountSink(threads, out);
+	return new StreamSink(threads, options.output == OUTPUT_JSON, out);
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ KSolve+ - Puzzle solving program.
+ Copyright (C) 2007-2013 Kre Krig and Michael Gottlieb
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Counters for the --stats option
+
+#ifndef STATS_H
+#define STATS_H
+
+// Set all counters to 0, with one for each pruning table of the puzzle
+static void clearStats(SearchStats& stats, CompiledPuzzle& puzzle){
+	stats.pruned.assign(2 * puzzle.sets.size() + puzzle.joints.size(), 0);
+	stats.checked.assign(2 * puzzle.sets.size() + puzzle.joints.size(), 0);
+	stats.inversePruned = 0;
+	stats.inverseChecked = 0;
+	stats.forbidden = 0;
+	stats.blocked = 0;
+	stats.limited = 0;
+	stats.solutions = 0;
+}
+
+static void addStats(SearchStats& total, SearchStats& stats){
+	for (unsigned int t = 0; t < stats.pruned.size(); t++) {
+		total.pruned[t] += stats.pruned[t];
+		total.checked[t] += stats.checked[t];
+	}
+	total.inversePruned += stats.inversePruned;
+	total.inverseChecked += stats.inverseChecked;
+	total.forbidden += stats.forbidden;
+	total.blocked += stats.blocked;
+	total.limited += stats.limited;
+	total.solutions += stats.solutions;
+}
+
+// Print the counters for one depth, which took this many nodes and seconds
+static void printStats(SearchStats& stats, CompiledPuzzle& puzzle, long long nodes, double seconds, std::ostream& out){
+	out << "  " << nodes << " nodes in " << (long long)(seconds * 1000 + 0.5) / 1000.0 << "s";
+	if (seconds > 0)
+		out << " (" << (long long)(nodes / seconds) << " nodes/s)";
+	out << ", " << stats.solutions << " solutions\n";
+
+	// only the tables the puzzle has
+	out << "  Pruned:";
+	bool first = true;
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		if (set.otabletype != TABLE_TYPE_NONE || stats.pruned[2 * s] > 0) {
+			out << (first ? " " : ", ") << set.name << " orientation " << stats.pruned[2 * s] << "/" << stats.checked[2 * s];
+			first = false;
+		}
+		if (set.ptabletype != TABLE_TYPE_NONE || stats.pruned[2 * s + 1] > 0) {
+			out << (first ? " " : ", ") << set.name << " permutation " << stats.pruned[2 * s + 1] << "/" << stats.checked[2 * s + 1];
+			first = false;
+		}
+	}
+	for (unsigned int j = 0; j < puzzle.joints.size(); j++) {
+		int t = 2 * puzzle.sets.size() + j;
+		out << (first ? " " : ", ") << puzzle.joints[j].name << " " << stats.pruned[t] << "/" << stats.checked[t];
+		first = false;
+	}
+	if (first)
+		out << " none";
+	if (stats.inverseChecked > 0)
+		out << ", inverse orientation " << stats.inversePruned << "/" << stats.inverseChecked;
+	out << "\n";
+	out << "  Rejected: " << stats.forbidden << " forbidden or redundant, " << stats.blocked << " by blocks, " << stats.limited << " by move limits\n";
+}
+
+#endif
@@ -0,0 +1,367 @@
+/*
+ KSolve+ - Puzzle solving program.
+ Copyright (C) 2007-2013 Kre Krig and Michael Gottlieb
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Functions for finding and using the symmetries of a puzzle
+
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+// Find the symmetries of the compiled puzzle. A symmetry moves the slots of each
+// set around (keeping orientations) and renames the pieces so that every move
+// becomes another move (a power of a parent move becomes the same power of
+// another parent move), and the solved state and the ignored pieces stay the same.
+// The identity is always the first symmetry.
+static void findSymmetries(CompiledPuzzle& puzzle, std::vector<unsigned char>& ignore, std::set<MovePair>& forbidden, std::set<MovePair>& commuting) {
+	int nMoves = puzzle.moves.size();
+	puzzle.symmetries.clear();
+
+	// which power of its parent each move is (parents are numbered in move order)
+	std::vector<int> parents;
+	std::vector<int> power (nMoves, 0);
+	std::map<std::pair<int, int>, int> byPower; // (parent, power) -> move
+	for (int m = 0; m < nMoves; m++) {
+		if (puzzle.moves[m].id != puzzle.moves[m].parentID)
+			continue;
+		parents.push_back(m);
+		std::vector<unsigned short> source = puzzle.moves[m].source;
+		std::vector<unsigned char> twist = puzzle.moves[m].twist;
+		for (int k = 1; k <= nMoves; k++) {
+			for (int n = 0; n < nMoves; n++)
+				if (puzzle.moves[n].parent == puzzle.moves[m].parent && puzzle.moves[n].source == source && puzzle.moves[n].twist == twist) {
+					power[n] = k;
+					byPower[std::pair<int, int>(puzzle.moves[m].parent, k)] = n;
+				}
+			composeMoves(source, twist, puzzle.moves[m], puzzle);
+		}
+	}
+	int nParents = parents.size();
+
+	// parent moves can only map to parent moves that look alike
+	std::vector<std::vector<int> > signature (nParents);
+	for (int a = 0; a < nParents; a++) {
+		compiledmove& move = puzzle.moves[parents[a]];
+		for (int m = 0; m < nMoves; m++)
+			if (puzzle.moves[m].parent == move.parent)
+				signature[a].push_back(power[m]);
+		std::sort(signature[a].begin(), signature[a].end());
+		for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+			int moved = 0;
+			for (int i = 0; i < puzzle.sets[s].size; i++)
+				if (move.moved[puzzle.sets[s].poffset + i])
+					moved++;
+			signature[a].push_back(moved);
+		}
+	}
+	std::vector<char> commutes (nParents * nParents, 0);
+	std::vector<char> skip (nParents * nParents, 0);
+	std::set<MovePair>::iterator pairIter;
+	for (pairIter = commuting.begin(); pairIter != commuting.end(); pairIter++) {
+		int a = puzzle.moves[puzzle.moveIndex[pairIter->first]].parent;
+		int b = puzzle.moves[puzzle.moveIndex[pairIter->second]].parent;
+		commutes[a * nParents + b] = 1;
+		commutes[b * nParents + a] = 1;
+		skip[a * nParents + b] = 1;
+	}
+
+	// try every mapping of the parent moves that keeps signatures and commuting pairs
+	std::vector<int> image (nParents, -1);
+	std::vector<char> used (nParents, 0);
+	std::vector<int> choice (nParents, -1);
+	int tries = 0;
+	int a = 0;
+	while (a >= 0 && nParents > 0 && tries < MAX_SYMMETRY_TRIES) {
+		// next candidate for parent a
+		if (choice[a] >= 0)
+			used[choice[a]] = 0;
+		int b = choice[a] + 1;
+		for (; b < nParents; b++) {
+			if (used[b] || signature[a] != signature[b])
+				continue;
+			bool fits = true;
+			for (int c = 0; c < a && fits; c++)
+				if (commutes[c * nParents + a] != commutes[image[c] * nParents + b])
+					fits = false;
+			if (fits)
+				break;
+		}
+		if (b >= nParents) {
+			choice[a] = -1;
+			a--;
+			continue;
+		}
+		choice[a] = b;
+		image[a] = b;
+		used[b] = 1;
+		if (a < nParents - 1) {
+			a++;
+			continue;
+		}
+
+		// all parents mapped; map the other moves by power, then look for the slots
+		tries++;
+		compiledsymmetry symmetry;
+		symmetry.move.resize(nMoves);
+		bool ok = true;
+		for (int m = 0; m < nMoves && ok; m++) {
+			std::map<std::pair<int, int>, int>::iterator found = byPower.find(std::pair<int, int>(image[puzzle.moves[m].parent], power[m]));
+			if (found == byPower.end())
+				ok = false;
+			else
+				symmetry.move[m] = found->second;
+		}
+		if (ok && findSymmetrySlots(puzzle, ignore, symmetry)) {
+			symmetry.keepsOrder = true;
+			for (int m = 0; m < nMoves; m++)
+				if (puzzle.moves[m].qtm != puzzle.moves[symmetry.move[m]].qtm)
+					symmetry.keepsOrder = false;
+			for (int c = 0; c < nParents; c++)
+				for (int d = 0; d < nParents; d++)
+					if (skip[c * nParents + d] != skip[image[c] * nParents + image[d]])
+						symmetry.keepsOrder = false;
+			std::set<MovePair>::iterator forbiddenIter;
+			for (forbiddenIter = forbidden.begin(); forbiddenIter != forbidden.end() && symmetry.keepsOrder; forbiddenIter++) {
+				int x = puzzle.moves[symmetry.move[puzzle.moveIndex[forbiddenIter->first]]].id;
+				int y = puzzle.moves[symmetry.move[puzzle.moveIndex[forbiddenIter->second]]].id;
+				if (forbidden.find(MovePair(x, y)) == forbidden.end())
+					symmetry.keepsOrder = false;
+			}
+			puzzle.symmetries.push_back(symmetry);
+		}
+	}
+
+	// the identity always works; make sure it is there and comes first
+	bool identity = !puzzle.symmetries.empty();
+	for (int m = 0; m < nMoves && identity; m++)
+		if (puzzle.symmetries[0].move[m] != m)
+			identity = false;
+	if (!identity || tries >= MAX_SYMMETRY_TRIES) {
+		puzzle.symmetries.clear();
+		compiledsymmetry symmetry;
+		for (int m = 0; m < nMoves; m++)
+			symmetry.move.push_back(m);
+		findSymmetrySlots(puzzle, ignore, symmetry);
+		symmetry.keepsOrder = true;
+		puzzle.symmetries.push_back(symmetry);
+	}
+
+	// only one relabeling was kept for each mapping of the moves, so add whatever
+	// is missing to make the symmetries a group
+	for (unsigned int i = 0; i < puzzle.symmetries.size(); i++) {
+		for (unsigned int j = 0; j < puzzle.symmetries.size() && puzzle.symmetries.size() <= MAX_SYMMETRIES; j++) {
+			compiledsymmetry product = composeSymmetries(puzzle.symmetries[i], puzzle.symmetries[j], puzzle);
+			bool known = false;
+			for (unsigned int k = 0; k < puzzle.symmetries.size() && !known; k++)
+				if (puzzle.symmetries[k].slot == product.slot && puzzle.symmetries[k].label == product.label)
+					known = true;
+			if (!known)
+				puzzle.symmetries.push_back(product);
+		}
+	}
+	if (puzzle.symmetries.size() > MAX_SYMMETRIES)
+		puzzle.symmetries.resize(1);
+	findSetSymmetries(puzzle);
+}
+
+// The distinct ways the symmetries of the puzzle act on each set
+static void findSetSymmetries(CompiledPuzzle& puzzle) {
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		set.symmetries.clear();
+		for (unsigned int g = 0; g < puzzle.symmetries.size(); g++) {
+			setsymmetry action;
+			for (int i = 0; i < set.size; i++)
+				action.slot.push_back(puzzle.symmetries[g].slot[set.poffset + i] - set.poffset);
+			for (int l = 0; l <= MAX_COMPILED_VALUE; l++)
+				action.label.push_back(puzzle.symmetries[g].label[s][l]);
+			bool known = false;
+			for (unsigned int k = 0; k < set.symmetries.size() && !known; k++)
+				if (set.symmetries[k].slot == action.slot && set.symmetries[k].label == action.label)
+					known = true;
+			if (!known)
+				set.symmetries.push_back(action);
+		}
+	}
+}
+
+// Apply move to a move given as source and twist arrays (first the old move, then this one)
+static void composeMoves(std::vector<unsigned short>& source, std::vector<unsigned char>& twist, compiledmove& move, CompiledPuzzle& puzzle) {
+	std::vector<unsigned short> newSource (puzzle.stateSize);
+	std::vector<unsigned char> newTwist (puzzle.stateSize);
+	for (int i = 0; i < puzzle.stateSize; i++) {
+		int from = move.source[i];
+		newSource[i] = source[from];
+		newTwist[i] = (twist[from] + move.twist[i]) % puzzle.modulus[i];
+	}
+	source = newSource;
+	twist = newTwist;
+}
+
+// Find where the symmetry sends each slot, given what it does to the moves. The
+// moves tie the slots together: if slot i goes to slot j, the slot a move takes
+// a piece into i from must go to the slot the image move takes a piece into j
+// from. So we guess where one slot goes and follow the moves from there, backing
+// up if the guess leads to a contradiction.
+static bool findSymmetrySlots(CompiledPuzzle& puzzle, std::vector<unsigned char>& ignore, compiledsymmetry& symmetry) {
+	std::vector<int> slot (puzzle.stateSize, -1);
+	std::vector<char> taken (puzzle.stateSize, 0);
+	int steps = 0;
+	return guessSymmetrySlots(puzzle, ignore, symmetry, slot, taken, steps);
+}
+
+static bool guessSymmetrySlots(CompiledPuzzle& puzzle, std::vector<unsigned char>& ignore, compiledsymmetry& symmetry, std::vector<int>& slot, std::vector<char>& taken, int& steps) {
+	// first permutation slot we don't know yet
+	int set = -1, first = -1;
+	for (unsigned int s = 0; s < puzzle.sets.size() && first == -1; s++)
+		for (int i = 0; i < puzzle.sets[s].size && first == -1; i++)
+			if (slot[puzzle.sets[s].poffset + i] == -1) {
+				set = s;
+				first = puzzle.sets[s].poffset + i;
+			}
+	if (first == -1) {
+		symmetry.slot.assign(slot.begin(), slot.end());
+		return labelSymmetry(puzzle, symmetry);
+	}
+
+	compiledset& current = puzzle.sets[set];
+	for (int j = current.poffset; j < current.poffset + current.size; j++) {
+		if (taken[j] || ++steps > MAX_SYMMETRY_TRIES)
+			continue;
+		std::vector<int> trySlot = slot;
+		std::vector<char> tryTaken = taken;
+		std::vector<std::pair<int, int> > queue;
+		queue.push_back(std::pair<int, int>(first, j));
+		bool fits = true;
+		while (!queue.empty() && fits) {
+			int from = queue.back().first;
+			int to = queue.back().second;
+			queue.pop_back();
+			if (trySlot[from] != -1) {
+				fits = (trySlot[from] == to);
+				continue;
+			}
+			int o = current.size; // orientation byte of the same slot
+			if (tryTaken[to] || puzzle.solved[from + o] != puzzle.solved[to + o] || (!ignore.empty() && (ignore[from] != ignore[to] || ignore[from + o] != ignore[to + o]))) {
+				fits = false;
+				continue;
+			}
+			trySlot[from] = to;
+			tryTaken[to] = 1;
+			trySlot[from + o] = to + o;
+			tryTaken[to + o] = 1;
+			for (unsigned int m = 0; m < puzzle.moves.size() && fits; m++) {
+				compiledmove& move = puzzle.moves[m];
+				compiledmove& image = puzzle.moves[symmetry.move[m]];
+				if (move.twist[from + o] != image.twist[to + o])
+					fits = false;
+				else
+					queue.push_back(std::pair<int, int>(move.source[from], image.source[to]));
+			}
+		}
+		if (fits && guessSymmetrySlots(puzzle, ignore, symmetry, trySlot, tryTaken, steps)) {
+			slot = trySlot;
+			taken = tryTaken;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Work out how the symmetry renames the pieces of each set, from what it does to
+// the solved state. Fails if the solved state can't be kept.
+static bool labelSymmetry(CompiledPuzzle& puzzle, compiledsymmetry& symmetry) {
+	symmetry.label.assign(puzzle.sets.size(), std::vector<unsigned char>(MAX_COMPILED_VALUE + 1, 0));
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		std::vector<char> known (MAX_COMPILED_VALUE + 1, 0);
+		std::vector<char> used (MAX_COMPILED_VALUE + 1, 0);
+		for (int i = set.poffset; i < set.poffset + set.size; i++) {
+			int from = puzzle.solved[i];
+			int to = puzzle.solved[symmetry.slot[i]];
+			if (known[from]) {
+				if (symmetry.label[s][from] != to)
+					return false;
+				continue;
+			}
+			if (used[to])
+				return false;
+			known[from] = 1;
+			used[to] = 1;
+			symmetry.label[s][from] = to;
+		}
+	}
+	return true;
+}
+
+// The symmetry that does first, then second
+static compiledsymmetry composeSymmetries(compiledsymmetry& first, compiledsymmetry& second, CompiledPuzzle& puzzle) {
+	compiledsymmetry product;
+	product.slot.resize(puzzle.stateSize);
+	for (int i = 0; i < puzzle.stateSize; i++)
+		product.slot[i] = second.slot[first.slot[i]];
+	product.label = first.label;
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++)
+		for (int l = 0; l <= MAX_COMPILED_VALUE; l++)
+			product.label[s][l] = second.label[s][first.label[s][l]];
+	product.move.resize(puzzle.moves.size());
+	for (unsigned int m = 0; m < puzzle.moves.size(); m++)
+		product.move[m] = second.move[first.move[m]];
+	product.keepsOrder = first.keepsOrder && second.keepsOrder;
+	return product;
+}
+
+// Apply a symmetry to a flat state
+static void applySymmetry(const unsigned char* state, unsigned char* new_state, compiledsymmetry& symmetry, CompiledPuzzle& puzzle) {
+	for (unsigned int s = 0; s < puzzle.sets.size(); s++) {
+		compiledset& set = puzzle.sets[s];
+		for (int i = set.poffset; i < set.poffset + set.size; i++) {
+			new_state[symmetry.slot[i]] = symmetry.label[s][state[i]];
+			new_state[symmetry.slot[i + set.size]] = state[i + set.size];
+		}
+	}
+}
+
+// Apply a symmetry to a sequence of moves
+static void applySymmetry(const int* moves, int* new_moves, int length, compiledsymmetry& symmetry) {
+	for (int m = 0; m < length; m++)
+		new_moves[m] = symmetry.move[moves[m]];
+}
+
+// The smallest key among the symmetric images of one set's permutation (or orientation),
+// so that symmetric positions share one entry in a partial pruning table
+static std::vector<long long> canonicalKey(std::vector<int> values, std::vector<setsymmetry>& symmetries, bool permutation) {
+	std::vector<long long> best = packVector(values);
+	std::vector<int> image (values.size());
+	for (unsigned int g = 1; g < symmetries.size(); g++) {
+		for (unsigned int i = 0; i < values.size(); i++)
+			image[symmetries[g].slot[i]] = (permutation && values[i] >= 0) ? symmetries[g].label[values[i]] : values[i];
+		std::vector<long long> key = packVector(image);
+		if (key < best)
+			best = key;
+	}
+	return best;
+}
+
+// canonicalKey for a set in a compiled state
+static std::vector<long long> canonicalKey(unsigned char values[], int size, std::vector<setsymmetry>& symmetries, bool permutation) {
+	if (symmetries.size() <= 1)
+		return packVector(values, size);
+	return canonicalKey(std::vector<int>(values, values + size), symmetries, permutation);
+}
+
+#endif
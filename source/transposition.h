@@ -0,0 +1,99 @@
+/*
+ KSolve+ - Puzzle solving program.
+ Copyright (C) 2007-2013 Kre Krig and Michael Gottlieb
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Functions for the transposition table, which remembers positions the search
+// has already found to have no solution
+
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+// Set up an empty table using about this many megabytes
+static void initTranspositionTable(TranspositionTable& table, CompiledPuzzle& puzzle, int megabytes){
+	unsigned long long count = 1;
+	while (count * 4 * sizeof(unsigned long long) <= ((unsigned long long)megabytes << 20))
+		count *= 2;
+	table.entries.assign(2 * count, 0);
+	table.mask = count - 1;
+
+	// random keys for every value of every byte (splitmix64, so runs are repeatable)
+	unsigned long long seed = 0;
+	table.zobrist.resize(puzzle.stateSize * 256);
+	for (unsigned int i = 0; i < table.zobrist.size(); i++) {
+		seed += 0x9E3779B97F4A7C15ULL;
+		unsigned long long z = seed;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		table.zobrist[i] = z ^ (z >> 31);
+	}
+
+	// only the bytes a move changes need to be rehashed after it
+	table.changed.resize(puzzle.moves.size());
+	for (unsigned int m = 0; m < puzzle.moves.size(); m++) {
+		table.changed[m].clear();
+		for (int i = 0; i < puzzle.stateSize; i++)
+			if (puzzle.moves[m].source[i] != i || puzzle.moves[m].twist[i] != 0)
+				table.changed[m].push_back(i);
+	}
+}
+
+// Forget everything, e.g. before a scramble with other rules
+static void clearTranspositionTable(TranspositionTable& table){
+	std::fill(table.entries.begin(), table.entries.end(), 0);
+}
+
+static unsigned long long hashState(const unsigned char* state, TranspositionTable& table, int size){
+	unsigned long long hash = 0;
+	for (int i = 0; i < size; i++)
+		hash ^= table.zobrist[i * 256 + state[i]];
+	return hash;
+}
+
+// The hash of new_state, which move took us to from state
+static unsigned long long updateHash(unsigned long long hash, const unsigned char* state, const unsigned char* new_state, TranspositionTable& table, int move){
+	std::vector<int>& changed = table.changed[move];
+	for (unsigned int c = 0; c < changed.size(); c++) {
+		int i = changed[c];
+		hash ^= table.zobrist[i * 256 + state[i]] ^ table.zobrist[i * 256 + new_state[i]];
+	}
+	return hash;
+}
+
+// The moves allowed next depend on the automaton state too, so it is part of the key
+static unsigned long long tableKey(unsigned long long hash, int moveState){
+	return hash ^ ((unsigned long long)(moveState + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+// Is this position (with this automaton state) known to have no solution of this depth?
+static bool tableLookup(TranspositionTable& table, unsigned long long hash, int moveState, int depth){
+	unsigned long long key = tableKey(hash, moveState);
+	unsigned long long* entry = &table.entries[2 * (key & table.mask)];
+	unsigned long long check = entry[0];
+	unsigned long long data = entry[1];
+	return data == (unsigned long long)depth && (check ^ data) == key;
+}
+
+// Remember that this position has no solution of this depth
+static void tableStore(TranspositionTable& table, unsigned long long hash, int moveState, int depth){
+	unsigned long long key = tableKey(hash, moveState);
+	unsigned long long* entry = &table.entries[2 * (key & table.mask)];
+	entry[0] = key ^ (unsigned long long)depth;
+	entry[1] = depth;
+}
+
+#endif
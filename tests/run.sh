@@ -0,0 +1,30 @@
+#!/bin/sh
+# Regression tests: solve the scrambles in tests/NAME.txt with puzzles/DEF.def
+# and compare the depths and solutions printed with tests/NAME.out. Solutions
+# are sorted within each depth, since threads can find them in any order.
+# Run from the top directory, after building ksolve.
+
+KSOLVE=${KSOLVE:-./ksolve}
+WORK=$(mktemp -d)
+FAILED=0
+
+check() {
+	cp puzzles/$1.def $WORK/
+	$KSOLVE $WORK/$1.def tests/$2.txt | tr -d '\r' |
+		grep -E '^(Solving|Depth|Phases:|  |The whole|Max depth)' |
+		awk '/^  / { print | "sort"; next } { close("sort"); print }' > $WORK/$2.out
+	if diff -u tests/$2.out $WORK/$2.out; then
+		echo "ok   $2"
+	else
+		echo "FAIL $2"
+		FAILED=1
+	fi
+}
+
+check 2x2x2 solved_slack
+check Bicube short_algs
+check 2x2x2 movelimits_depths
+check 2x2x2 phases_boundary
+
+rm -rf $WORK
+exit $FAILED